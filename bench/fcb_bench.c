@@ -0,0 +1,413 @@
+/**
+ * @file fcb_bench.c
+ * @brief Throughput, latency, mount, recovery and keyed lookup benchmark of
+ * the FCB
+ *
+ * Drives the flash_mem emulator under a NOR timing model. Every figure is
+ * host CPU time spent in the FCB plus the modelled device time of the
+ * flash operations it issued, so results do not depend on the speed of the
+ * emulator's memcpy. The report is a single JSON object on stdout.
+ *
+ * Usage: fcb_bench [appends_per_size]
+ */
+
+#define _POSIX_C_SOURCE 199309L /* clock_gettime() */
+
+#include "fcb.h"
+#include "flash_mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*============================================================================
+ * Configuration
+ *============================================================================*/
+
+#define BENCH_SECTOR_SIZE 4096 /**< FCB sector size, one erase block */
+#define BENCH_DEFAULT_APPENDS 20000 /**< Appends per record size */
+#define BENCH_MAX_RECORD 1024 /**< Largest record size measured */
+#define BENCH_KV_SECTORS 4 /**< Sectors of the keyed lookup ring */
+#define BENCH_KV_PUTS 3000 /**< Records put by the keyed lookup run */
+
+/**
+ * @brief Timing model: a typical SPI NOR part.
+ */
+static const FlashMemCost bench_cost = {
+    .page_program_ns = 700000, /* 0.7 ms page program */
+    .erase_ns = 45000000,      /* 45 ms 4 KiB sector erase */
+    .read_ns_per_kb = 20000,   /* ~50 MB/s reads */
+};
+
+static const uint16_t bench_record_sizes[] = {16, 64, 256, 1024};
+static const uint32_t bench_sector_counts[] = {16, 64, 256, 1024};
+static const uint32_t bench_fill_levels[] = {0, 25, 50, 75, 100};
+static const uint32_t bench_tear_counts[] = {1, 8, 64};
+
+/**
+ * @brief The emulated device as a SPI part, read only through ops->read.
+ *
+ * flash_mem_dev itself is memory-mapped (XIP) and its reads cost nothing in
+ * the timing model.
+ */
+static FlashDev bench_dev;
+
+/*============================================================================
+ * Clock
+ *============================================================================*/
+
+/**
+ * @brief Host CPU time plus modelled device time.
+ *
+ * @return uint64_t Nanoseconds on the benchmark clock.
+ */
+static uint64_t bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec +
+         flash_mem_elapsed_ns();
+}
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Percentile of a sorted sample array.
+ *
+ * @param sorted Samples in ascending order.
+ * @param n Number of samples.
+ * @param permille Percentile in tenths of a percent (999 for p99.9).
+ * @return uint64_t The sample at that rank.
+ */
+static uint64_t bench_percentile(const uint64_t *sorted, size_t n,
+                                 uint32_t permille)
+{
+  size_t rank = (n * permille) / 1000;
+
+  return sorted[(rank < n) ? rank : n - 1];
+}
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+/**
+ * @brief Set up a freshly erased FCB over the first sectors of the device.
+ *
+ * @param fcb FCB to initialize.
+ * @param sectors Number of sectors.
+ * @param policy Behaviour when the buffer is full.
+ * @return int 0 on success, the fcb_mount() error code otherwise.
+ */
+static int bench_setup(Fcb *fcb, uint32_t sectors, FcbFullPolicy policy)
+{
+  memset(fcb, 0, sizeof(*fcb));
+  fcb->dev = &bench_dev;
+  fcb->first_sector = 0;
+  fcb->last_sector = sectors - 1;
+  fcb->sector_size = BENCH_SECTOR_SIZE;
+  fcb->full_policy = policy;
+
+  flash_full_erase();
+  return fcb_mount(fcb);
+}
+
+/**
+ * @brief Append records until a share of the ring is in use.
+ *
+ * @param fcb Mounted, empty FCB.
+ * @param percent Target fill level of the ring.
+ * @param len Record size.
+ * @return uint32_t Number of records written.
+ */
+static uint32_t bench_fill(Fcb *fcb, uint32_t percent, uint16_t len)
+{
+  static uint8_t payload[BENCH_MAX_RECORD];
+  uint32_t sectors = fcb->last_sector - fcb->first_sector + 1;
+  uint64_t target = (uint64_t)sectors * BENCH_SECTOR_SIZE * percent / 100;
+  uint64_t written = 0;
+  uint32_t count = 0;
+
+  while (written < target)
+  {
+    memcpy(payload, &count, sizeof(count));
+    if (fcb_append(fcb, payload, len) != 0)
+    {
+      break;
+    }
+
+    written += len + 12; /* payload and item key */
+    count++;
+  }
+
+  return count;
+}
+
+/*============================================================================
+ * Benchmarks
+ *============================================================================*/
+
+/**
+ * @brief Append throughput and latency for one record size.
+ */
+static void bench_append(uint16_t len, uint32_t appends, uint64_t *lat,
+                         int last)
+{
+  static uint8_t payload[BENCH_MAX_RECORD];
+  Fcb fcb;
+
+  /* Overwrite mode keeps the ring appendable for any number of records */
+  bench_setup(&fcb, FLASH_SIZE / BENCH_SECTOR_SIZE, FCB_FULL_OVERWRITE);
+  memset(payload, 0xA5, sizeof(payload));
+
+  uint32_t done = 0;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < appends; i++)
+  {
+    uint64_t t0 = bench_now();
+    int rc = fcb_append(&fcb, payload, len);
+    lat[i] = bench_now() - t0;
+    if (rc != 0)
+    {
+      break;
+    }
+    done++;
+  }
+  uint64_t total = bench_now() - start;
+
+  qsort(lat, done, sizeof(lat[0]), bench_cmp_u64);
+
+  double seconds = (double)total / 1e9;
+  printf("    {\"record_size\": %u, \"appends\": %u, \"appends_per_s\": %.1f, "
+         "\"bytes_per_s\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+         "\"p999_ns\": %llu, \"max_ns\": %llu}%s\n",
+         len, done, done / seconds, (double)done * len / seconds,
+         (unsigned long long)bench_percentile(lat, done, 500),
+         (unsigned long long)bench_percentile(lat, done, 990),
+         (unsigned long long)bench_percentile(lat, done, 999),
+         (unsigned long long)(done ? lat[done - 1] : 0), last ? "" : ",");
+}
+
+/**
+ * @brief Mount time for one partition size and fill level.
+ */
+static void bench_mount(uint32_t sectors, uint32_t percent, int last)
+{
+  Fcb fcb;
+  bench_setup(&fcb, sectors, FCB_FULL_REJECT);
+  uint32_t records = bench_fill(&fcb, percent, 64);
+
+  Fcb again = fcb;
+  uint64_t t0 = bench_now();
+  int rc = fcb_mount(&again);
+  uint64_t elapsed = bench_now() - t0;
+  int ok = rc == 0 && again.write_addr == fcb.write_addr;
+
+  /* Same flash through the mapped view */
+  again = fcb;
+  again.dev = &flash_mem_dev;
+  t0 = bench_now();
+  rc = fcb_mount(&again);
+  uint64_t mapped = bench_now() - t0;
+  ok = ok && rc == 0 && again.write_addr == fcb.write_addr;
+
+  printf("    {\"sectors\": %u, \"fill_percent\": %u, \"records\": %u, "
+         "\"mount_ns\": %llu, \"mount_mapped_ns\": %llu, \"ok\": %s}%s\n",
+         sectors, percent, records, (unsigned long long)elapsed,
+         (unsigned long long)mapped, ok ? "true" : "false", last ? "" : ",");
+}
+
+/**
+ * @brief Mount and full read-back after torn writes.
+ *
+ * Power is cut halfway through the payload of each torn record, followed by
+ * a remount as after a reset.
+ */
+static void bench_recovery(uint32_t tears, int last)
+{
+  static uint8_t payload[BENCH_MAX_RECORD];
+  const uint32_t sectors = 64;
+  const uint16_t len = 64;
+  Fcb fcb;
+
+  bench_setup(&fcb, sectors, FCB_FULL_REJECT);
+  uint32_t records = bench_fill(&fcb, 25, len);
+
+  memset(payload, 0x3C, sizeof(payload));
+
+  for (uint32_t i = 0; i < tears; i++)
+  {
+    /* Item key and half of the payload reach the flash */
+    flash_mem_cut_power(12 + len / 2);
+    fcb_append(&fcb, payload, len);
+    flash_mem_restore_power();
+    if (fcb_mount(&fcb) != 0)
+    {
+      break;
+    }
+    records++;
+
+    /* Space the torn records out with intact ones */
+    for (uint32_t j = 0; j < 16 && fcb_append(&fcb, payload, len) == 0; j++)
+    {
+      records++;
+    }
+  }
+
+  Fcb again = fcb;
+  uint32_t intact = 0;
+  uint32_t corrupt = 0;
+  uint64_t t0 = bench_now();
+  int rc = fcb_mount(&again);
+  for (;;)
+  {
+    uint16_t got;
+    int read_rc = fcb_read(&again, payload, sizeof(payload), &got);
+    if (read_rc == 0)
+    {
+      intact++;
+    } else if (read_rc == -4)
+    {
+      corrupt++;
+    } else
+    {
+      break;
+    }
+  }
+  uint64_t elapsed = bench_now() - t0;
+
+  printf("    {\"torn_writes\": %u, \"records\": %u, \"intact\": %u, "
+         "\"corrupt\": %u, \"recovery_ns\": %llu, \"ok\": %s}%s\n",
+         tears, records, intact, corrupt, (unsigned long long)elapsed,
+         (rc == 0) ? "true" : "false", last ? "" : ",");
+}
+
+/*============================================================================
+ * Main
+ *============================================================================*/
+
+/**
+ * @brief Keyed lookup latency while the ring is reused.
+ *
+ * One ID is put and consumed, then another is put over and over, consumed
+ * now and then, until the sector of the first has been erased and written
+ * again. The lookup of the consumed ID must keep failing throughout.
+ */
+static void bench_kv(void)
+{
+  static FcbKvSlot index[16];
+  Fcb fcb;
+
+  memset(&fcb, 0, sizeof(fcb));
+  fcb.dev = &bench_dev;
+  fcb.first_sector = 0;
+  fcb.last_sector = BENCH_KV_SECTORS - 1;
+  fcb.sector_size = BENCH_SECTOR_SIZE;
+  fcb.kv_index = index;
+  fcb.kv_slots = sizeof(index) / sizeof(index[0]);
+
+  flash_full_erase();
+  uint32_t value = 0;
+  int ok = fcb_mount(&fcb) == 0 && fcb_put(&fcb, 1, &value, 4) == 0 &&
+           fcb_consume_until(&fcb, fcb.write_addr) >= 0;
+
+  uint32_t first_write = fcb.write_addr;
+  int wrapped = 0;
+  int reused = 0;
+  uint64_t total = 0;
+  uint32_t i;
+  for (i = 0; ok && i < BENCH_KV_PUTS; i++)
+  {
+    if (i % 100 == 99)
+    {
+      fcb_consume_until(&fcb, fcb.write_addr);
+    }
+
+    uint32_t prev_write = fcb.write_addr;
+    value = i;
+    ok = fcb_put(&fcb, 2, &value, 4) == 0;
+    wrapped = wrapped || fcb.write_addr < prev_write;
+    reused = reused || (wrapped && fcb.write_addr > first_write);
+
+    uint8_t buf[4];
+    uint64_t t0 = bench_now();
+    int rc = fcb_get_latest(&fcb, 1, buf, sizeof(buf), NULL);
+    total += bench_now() - t0;
+    ok = ok && rc == -2;
+  }
+
+  ok = ok && reused;
+
+  printf("  \"kv\": {\"sectors\": %u, \"puts\": %u, "
+         "\"lookup_avg_ns\": %llu, \"ok\": %s},\n",
+         BENCH_KV_SECTORS, i, (unsigned long long)(i ? total / i : 0),
+         ok ? "true" : "false");
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t appends = BENCH_DEFAULT_APPENDS;
+  if (argc > 1)
+  {
+    appends = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+
+  uint64_t *lat = malloc(sizeof(uint64_t) * (appends ? appends : 1));
+  if (lat == NULL)
+  {
+    return 1;
+  }
+
+  flash_mem_set_cost(&bench_cost);
+  bench_dev = flash_mem_dev;
+  bench_dev.base = NULL;
+
+  printf("{\n");
+  printf("  \"version\": 1,\n");
+  printf("  \"cost_model\": {\"page_program_ns\": %u, \"erase_ns\": %u, "
+         "\"read_ns_per_kb\": %u, \"sector_size\": %u},\n",
+         bench_cost.page_program_ns, bench_cost.erase_ns,
+         bench_cost.read_ns_per_kb, BENCH_SECTOR_SIZE);
+
+  size_t n = sizeof(bench_record_sizes) / sizeof(bench_record_sizes[0]);
+  printf("  \"append\": [\n");
+  for (size_t i = 0; i < n; i++)
+  {
+    bench_append(bench_record_sizes[i], appends, lat, i + 1 == n);
+  }
+  printf("  ],\n");
+
+  size_t ns = sizeof(bench_sector_counts) / sizeof(bench_sector_counts[0]);
+  size_t nf = sizeof(bench_fill_levels) / sizeof(bench_fill_levels[0]);
+  printf("  \"mount\": [\n");
+  for (size_t i = 0; i < ns; i++)
+  {
+    for (size_t j = 0; j < nf; j++)
+    {
+      bench_mount(bench_sector_counts[i], bench_fill_levels[j],
+                  i + 1 == ns && j + 1 == nf);
+    }
+  }
+  printf("  ],\n");
+
+  bench_kv();
+
+  n = sizeof(bench_tear_counts) / sizeof(bench_tear_counts[0]);
+  printf("  \"recovery\": [\n");
+  for (size_t i = 0; i < n; i++)
+  {
+    bench_recovery(bench_tear_counts[i], i + 1 == n);
+  }
+  printf("  ]\n");
+  printf("}\n");
+
+  free(lat);
+  return 0;
+}
@@ -1,35 +1,306 @@
 #include "crc32.h"
+#include <string.h>
 
-static uint32_t crc32_table[256];
-static int table_initialized = 0;
-
-static void crc32_init_table(void) {
-  uint32_t polynomial = 0xEDB88320;
-  for (uint32_t i = 0; i < 256; i++) {
-    uint32_t crc = i;
-    for (uint32_t j = 0; j < 8; j++) {
-      if (crc & 1) {
-        crc = (crc >> 1) ^ polynomial;
-      } else {
-        crc >>= 1;
-      }
+/*============================================================================
+ * Engine Selection
+ *============================================================================*/
+
+/**
+ * @brief Available CRC32 engines.
+ *
+ * All engines compute the same reflected CRC32 (polynomial 0xEDB88320), they
+ * only differ in how many bytes are folded per step. The engine is chosen at
+ * build time with -DCRC32_ENGINE=CRC32_ENGINE_<NAME> (see the CRC32_ENGINE
+ * CMake cache variable); without it the fastest engine the compiler target
+ * advertises is used.
+ */
+#define CRC32_ENGINE_BYTE 0    /**< 256-entry table, one byte per step */
+#define CRC32_ENGINE_SLICE8 1  /**< Slicing-by-8 tables, 8 bytes per step */
+#define CRC32_ENGINE_SLICE16 2 /**< Slicing-by-16 tables, 16 bytes per step */
+#define CRC32_ENGINE_ARMV8 3   /**< ARMv8 CRC32 instructions (__crc32*) */
+#define CRC32_ENGINE_PCLMUL 4  /**< x86 carry-less multiply folding */
+#define CRC32_ENGINE_HW 5      /**< Board supplied peripheral (crc32_hw_update) */
+
+#ifndef CRC32_ENGINE
+#if defined(__ARM_FEATURE_CRC32)
+#define CRC32_ENGINE CRC32_ENGINE_ARMV8
+#elif defined(__PCLMUL__) && defined(__SSE4_1__)
+#define CRC32_ENGINE CRC32_ENGINE_PCLMUL
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CRC32_ENGINE CRC32_ENGINE_BYTE
+#else
+#define CRC32_ENGINE CRC32_ENGINE_SLICE8
+#endif
+#endif
+
+#if CRC32_ENGINE == CRC32_ENGINE_SLICE16
+#define CRC32_TABLE_ROWS 16
+#elif CRC32_ENGINE == CRC32_ENGINE_SLICE8 || CRC32_ENGINE == CRC32_ENGINE_PCLMUL
+#define CRC32_TABLE_ROWS 8
+#elif CRC32_ENGINE == CRC32_ENGINE_BYTE
+#define CRC32_TABLE_ROWS 1
+#else
+#define CRC32_TABLE_ROWS 0
+#endif
+
+#if CRC32_ENGINE == CRC32_ENGINE_ARMV8
+#include <arm_acle.h>
+#elif CRC32_ENGINE == CRC32_ENGINE_PCLMUL
+#include <immintrin.h>
+#endif
+
+#if CRC32_TABLE_ROWS > 0
+/*============================================================================
+ * Lookup Tables
+ *============================================================================*/
+
+/*
+ * crc32_table[0] is the classic byte-wise table. Row k holds the CRC of a
+ * byte followed by k zero bytes, which lets the slicing engines fold k + 1
+ * bytes with independent lookups. The tables are generated ahead of time by
+ * crc32_gentab.c and live in read-only memory, so no engine needs run-time
+ * initialization and all of them are safe to call from any context.
+ */
+#include "crc32_table.h"
+
+/*============================================================================
+ * Engines
+ *
+ * Every engine works on the raw (non-inverted) CRC register.
+ *============================================================================*/
+
+static uint32_t crc32_bytes(uint32_t crc, const uint8_t *p, size_t len)
+{
+  while (len--)
+  {
+    crc = (crc >> 8) ^ crc32_table[0][(crc ^ *p++) & 0xFF];
+  }
+
+  return crc;
+}
+#endif
+
+#if CRC32_TABLE_ROWS == 8
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *p, size_t len)
+{
+  while (len >= 8)
+  {
+    uint32_t one;
+    uint32_t two;
+    memcpy(&one, p, sizeof(one));
+    memcpy(&two, p + 4, sizeof(two));
+    one ^= crc;
+
+    crc = crc32_table[7][one & 0xFF] ^ crc32_table[6][(one >> 8) & 0xFF] ^
+          crc32_table[5][(one >> 16) & 0xFF] ^ crc32_table[4][one >> 24] ^
+          crc32_table[3][two & 0xFF] ^ crc32_table[2][(two >> 8) & 0xFF] ^
+          crc32_table[1][(two >> 16) & 0xFF] ^ crc32_table[0][two >> 24];
+
+    p += 8;
+    len -= 8;
+  }
+
+  return crc32_bytes(crc, p, len);
+}
+#endif
+
+#if CRC32_TABLE_ROWS == 16
+static uint32_t crc32_slice16(uint32_t crc, const uint8_t *p, size_t len)
+{
+  while (len >= 16)
+  {
+    uint32_t w[4];
+    memcpy(w, p, sizeof(w));
+    w[0] ^= crc;
+
+    crc = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+      uint32_t row = 15 - (i * 4);
+      crc ^= crc32_table[row][w[i] & 0xFF] ^
+             crc32_table[row - 1][(w[i] >> 8) & 0xFF] ^
+             crc32_table[row - 2][(w[i] >> 16) & 0xFF] ^
+             crc32_table[row - 3][w[i] >> 24];
     }
-    crc32_table[i] = crc;
+
+    p += 16;
+    len -= 16;
   }
-  table_initialized = 1;
+
+  return crc32_bytes(crc, p, len);
 }
+#endif
 
-uint32_t crc32_gen(const void *data, size_t len) {
-  if (!table_initialized) {
-    crc32_init_table();
+#if CRC32_ENGINE == CRC32_ENGINE_ARMV8
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *p, size_t len)
+{
+  while (len >= 8)
+  {
+    uint64_t d;
+    memcpy(&d, p, sizeof(d));
+    crc = __crc32d(crc, d);
+    p += 8;
+    len -= 8;
   }
 
-  const uint8_t *p = (const uint8_t *)data;
-  uint32_t crc = 0xFFFFFFFF;
+  if (len >= 4)
+  {
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    crc = __crc32w(crc, w);
+    p += 4;
+    len -= 4;
+  }
 
-  while (len--) {
-    crc = (crc >> 8) ^ crc32_table[(crc ^ *p++) & 0xFF];
+  while (len--)
+  {
+    crc = __crc32b(crc, *p++);
   }
 
+  return crc;
+}
+#endif
+
+#if CRC32_ENGINE == CRC32_ENGINE_PCLMUL
+/*
+ * Folding with carry-less multiplication, after Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction". The
+ * constants are the bit-reflected fold and Barrett constants for
+ * 0xEDB88320. Requires at least 64 bytes and a multiple of 16.
+ */
+static uint32_t crc32_pclmul_fold(uint32_t crc, const uint8_t *p, size_t len)
+{
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  __m128i x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+  __m128i x5;
+
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  p += 64;
+  len -= 64;
+
+  /* Fold four lanes in parallel */
+  while (len >= 64)
+  {
+    __m128i x6;
+    __m128i x7;
+    __m128i x8;
+
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *)(p + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                       _mm_loadu_si128((const __m128i *)(p + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                       _mm_loadu_si128((const __m128i *)(p + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                       _mm_loadu_si128((const __m128i *)(p + 0x30)));
+
+    p += 64;
+    len -= 64;
+  }
+
+  /* Fold the four lanes into one */
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /* Fold the remaining 16 byte blocks */
+  while (len >= 16)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *)p));
+    p += 16;
+    len -= 16;
+  }
+
+  /* Fold 128 bits down to 64 */
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits */
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *p, size_t len)
+{
+  if (len >= 64)
+  {
+    size_t bulk = len & ~(size_t)15;
+    crc = crc32_pclmul_fold(crc, p, bulk);
+    p += bulk;
+    len -= bulk;
+  }
+
+  return crc32_slice8(crc, p, len);
+}
+#endif
+
+/*============================================================================
+ * Public Functions
+ *============================================================================*/
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)data;
+
+  crc ^= 0xFFFFFFFF;
+
+#if CRC32_ENGINE == CRC32_ENGINE_ARMV8
+  crc = crc32_armv8(crc, p, len);
+#elif CRC32_ENGINE == CRC32_ENGINE_HW
+  crc = crc32_hw_update(crc, p, len);
+#elif CRC32_ENGINE == CRC32_ENGINE_PCLMUL
+  crc = crc32_pclmul(crc, p, len);
+#elif CRC32_ENGINE == CRC32_ENGINE_SLICE16
+  crc = crc32_slice16(crc, p, len);
+#elif CRC32_ENGINE == CRC32_ENGINE_SLICE8
+  crc = crc32_slice8(crc, p, len);
+#else
+  crc = crc32_bytes(crc, p, len);
+#endif
+
   return crc ^ 0xFFFFFFFF;
 }
+
+uint32_t crc32_gen(const void *data, size_t len)
+{
+  return crc32_update(0, data, len);
+}
@@ -16,4 +16,30 @@
  */
 uint32_t crc32_gen(const void *data, size_t len);
 
+/**
+ * @brief Continue a CRC32 calculation over another buffer.
+ *
+ * Start with a crc of 0 and feed the result of each call into the next one;
+ * the final value equals crc32_gen() over the concatenated buffers.
+ *
+ * @param crc  CRC32 of the preceding data (0 for the first buffer).
+ * @param data Pointer to the buffer.
+ * @param len  Length of the data in bytes.
+ * @return uint32_t CRC32 of the preceding data followed by this buffer.
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Board supplied CRC peripheral hook (CRC32_ENGINE_HW only).
+ *
+ * Must fold len bytes into the raw, non-inverted CRC register using the
+ * reflected 0xEDB88320 polynomial and return the new register value.
+ *
+ * @param crc  Current CRC register value.
+ * @param data Pointer to the buffer.
+ * @param len  Length of the data in bytes.
+ * @return uint32_t Updated CRC register value.
+ */
+uint32_t crc32_hw_update(uint32_t crc, const void *data, size_t len);
+
 #endif // CRC32_H
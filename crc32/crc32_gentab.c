@@ -0,0 +1,79 @@
+/**
+ * @file crc32_gentab.c
+ * @brief Host tool that generates crc32_table.h
+ *
+ * Emits the byte-wise CRC32 table and the slicing-by-16 extension rows as
+ * constant data, so the library never builds tables at run time. Each row is
+ * guarded by CRC32_TABLE_ROWS and only the rows the selected engine needs are
+ * compiled in.
+ *
+ * Usage: crc32_gentab > crc32_table.h
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define ROWS 16
+
+int main(void)
+{
+  static uint32_t table[ROWS][256];
+  uint32_t polynomial = 0xEDB88320;
+
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i;
+    for (uint32_t j = 0; j < 8; j++)
+    {
+      if (crc & 1)
+      {
+        crc = (crc >> 1) ^ polynomial;
+      }
+      else
+      {
+        crc >>= 1;
+      }
+    }
+    table[0][i] = crc;
+  }
+
+  /* Row k holds the CRC of a byte followed by k zero bytes */
+  for (uint32_t k = 1; k < ROWS; k++)
+  {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t prev = table[k - 1][i];
+      table[k][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+    }
+  }
+
+  printf("/* Generated by crc32_gentab.c, do not edit. */\n\n");
+  printf("#ifndef CRC32_TABLE_H\n#define CRC32_TABLE_H\n\n");
+  printf("#include <stdint.h>\n\n");
+  printf("#ifndef CRC32_TABLE_ROWS\n#define CRC32_TABLE_ROWS %d\n#endif\n\n",
+         ROWS);
+  printf("#if CRC32_TABLE_ROWS > %d\n", ROWS);
+  printf("#error \"crc32_table.h provides at most %d rows\"\n#endif\n\n", ROWS);
+  printf("static const uint32_t crc32_table[CRC32_TABLE_ROWS][256] = {\n");
+
+  for (uint32_t k = 0; k < ROWS; k++)
+  {
+    printf("#if CRC32_TABLE_ROWS > %u\n", k);
+    printf("    {\n");
+    for (uint32_t i = 0; i < 256; i += 5)
+    {
+      printf("       ");
+      for (uint32_t j = i; j < i + 5 && j < 256; j++)
+      {
+        printf(" 0x%08XU,", table[k][j]);
+      }
+      printf("\n");
+    }
+    printf("    },\n");
+    printf("#endif\n");
+  }
+
+  printf("};\n\n#endif // CRC32_TABLE_H\n");
+
+  return 0;
+}
@@ -8,7 +8,9 @@
 
 #include "fcb.h"
 #include "crc32.h"
-#include "flash_mem.h"
+#include "fcb_lz.h"
+#include "fcb_metrics.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -22,24 +24,82 @@
  * This structure is placed at the beginning of each sector and provides:
  * - Identification via magic number
  * - Ordering via monotonic sequence_id
+ * - Record numbering via first_record
+ * - Wear tracking via erase_count
  * - Integrity verification via header_crc
  * - Lifecycle tracking via state field
  *
- * @note The header_crc field covers ONLY magic and sequence_id (8 bytes).
+ * It is followed by room for a SectorSummary, programmed when the writer
+ * leaves the sector; the first item starts after both.
+ *
+ * @note The header_crc field covers the fields before it (16 bytes).
  *       The state field is placed AFTER header_crc since it is not included
  *       in the CRC calculation. This allows the header to be validated
  *       independently before reading the rest of the sector data.
  *
- * @note Structure is naturally aligned to 16 bytes (4 x uint32_t = 16 bytes).
+ * @note Right after an erase only magic and erase_count are programmed, so
+ *       the count survives until the sector is reserved; the remaining
+ *       fields are programmed over the erased bytes at that point.
+ *
+ * @note Structure is naturally aligned to 24 bytes (6 x uint32_t = 24 bytes).
  */
 typedef struct __attribute__((aligned(4)))
 {
-  uint32_t magic;       /**< Magic number (SECTOR_MAGIC = 0xCAFEBABE) */
-  uint32_t sequence_id; /**< Monotonic counter for sector ordering */
-  uint32_t header_crc;  /**< CRC32 of magic + sequence_id (8 bytes) */
+  uint32_t magic;        /**< Magic number (SECTOR_MAGIC = 0xCAFEBABE) */
+  uint32_t sequence_id;  /**< Monotonic counter for sector ordering */
+  uint32_t first_record; /**< Record number of the first item in the sector */
+  uint32_t erase_count;  /**< Number of times the sector has been erased */
+  uint32_t header_crc;   /**< CRC32 of all fields before it */
   uint32_t state; /**< Lifecycle state (STATE_FRESH/ALLOCATED/FULL/CONSUMED) */
 } SectorHeader;
 
+/**
+ * @brief Sector Summary Structure
+ *
+ * Programmed into the erased space reserved after the SectorHeader once the
+ * writer moves on to the next sector, so a sealed sector can be accounted
+ * for without walking its items. The last record of the sector is
+ * first_record + record_count - 1.
+ *
+ * @note data_crc chains the CRC32 of every item payload (ItemKey.crc) in
+ *       order. Popping items rewrites their status words but not their keys'
+ *       CRCs, so the aggregate stays valid for the life of the sector.
+ *
+ * @note A summary cut short by power loss fails summary_crc and the sector
+ *       is simply treated as unsealed.
+ */
+typedef struct __attribute__((aligned(4)))
+{
+  uint32_t magic;        /**< Magic number (SUMMARY_MAGIC = 0x5EA1ED00) */
+  uint32_t first_record; /**< Record number of the first item, as in the
+                            SectorHeader */
+  uint32_t record_count; /**< Items in the sector, popped ones included */
+  uint32_t used;         /**< Sector-relative end of the last item */
+  uint32_t data_crc;     /**< CRC32 over the item payload CRCs */
+  uint32_t summary_crc;  /**< CRC32 of all fields before it */
+} SectorSummary;
+
+/**
+ * @brief Mount Checkpoint Structure
+ *
+ * Appended to the checkpoint sectors (Fcb.ckpt_sectors) by
+ * fcb_checkpoint(), one per program unit aligned slot. Slots are used in
+ * order and a sector is erased only when the writer returns to it, so the
+ * newest checkpoint is the last one before the first erased slot of the
+ * sector with the highest counter.
+ */
+typedef struct __attribute__((aligned(4)))
+{
+  uint32_t magic;       /**< Magic number (CHECKPOINT_MAGIC = 0xC4EC9017) */
+  uint32_t counter;     /**< Incremented by every checkpoint */
+  uint32_t sector_id;   /**< Sequence ID of the write sector */
+  uint32_t write_addr;  /**< Fcb.write_addr */
+  uint32_t read_addr;   /**< Fcb.read_addr */
+  uint32_t delete_addr; /**< Fcb.delete_addr */
+  uint32_t next_record; /**< Fcb.next_record */
+  uint32_t crc;         /**< CRC32 of all fields before it */
+} MountCheckpoint;
+
 /* ============================================================================
  * Entry Header Definition
  * Total Size: 12 Bytes (4-byte aligned)
@@ -53,26 +113,203 @@ struct ItemKey
   uint32_t status; // Per-message lifecycle state
 };
 
+/**
+ * @brief Record Cache Entry Header
+ *
+ * Precedes the cached bytes of every item in Fcb.cache_buf, which is used
+ * as a byte ring: entries follow each other in append order and may wrap
+ * around the end of the buffer.
+ */
+typedef struct
+{
+  uint32_t addr; /**< Flash address of the item's ItemKey */
+  uint32_t len;  /**< Bytes cached: the ItemKey and the stored payload */
+} FcbCacheEntry;
+
+/**
+ * @brief Upper bound on the staging buffer used to coalesce program
+ * operations.
+ *
+ * The stage covers one device page, or a FCB_STAGE_SIZE aligned part of it
+ * on devices with larger pages, so that it stays on the stack.
+ */
+#ifndef FCB_STAGE_SIZE
+#define FCB_STAGE_SIZE 256
+#endif
+
+/**
+ * @brief Most items of one fcb_append_batch() not yet known to be
+ * programmed: those with bytes still in a stage, at least 13 bytes each,
+ * plus the one being staged.
+ */
+#define FCB_STAGE_ITEMS (FCB_STAGE_SIZE / (sizeof(struct ItemKey) + 1) + 2)
+
+/**
+ * @brief Staging buffer used to coalesce program operations.
+ *
+ * Holds the bytes destined for [addr, addr + len). It is flushed whenever it
+ * reaches a size boundary so each program stays within one page. After the
+ * first failed program nothing more is programmed.
+ */
+typedef struct
+{
+  uint32_t addr;               /**< Flash address of buf[0] */
+  uint32_t len;                /**< Number of bytes staged */
+  uint32_t size;               /**< Block size, the device page size up to
+                                  FCB_STAGE_SIZE */
+  int rc;                      /**< First program error, 0 if none */
+  uint32_t err_addr;           /**< Start of the failed program */
+  uint32_t err_end;            /**< End of the failed program */
+  uint8_t buf[FCB_STAGE_SIZE]; /**< Staged bytes */
+} FcbStage;
+
 /* Static assertion to verify struct size is exactly 12 bytes */
 _Static_assert(sizeof(struct ItemKey) == 12, "ItemKey must be 12 bytes");
 
-/* Static assertion to verify struct size is exactly 16 bytes */
-_Static_assert(sizeof(SectorHeader) == 16, "SectorHeader must be 16 bytes");
+/* Static assertion to verify struct size is exactly 24 bytes */
+_Static_assert(sizeof(SectorHeader) == 24, "SectorHeader must be 24 bytes");
+
+/* Static assertion to verify struct size is exactly 24 bytes */
+_Static_assert(sizeof(SectorSummary) == 24, "SectorSummary must be 24 bytes");
+
+/* Static assertion to verify struct size is exactly 32 bytes */
+_Static_assert(sizeof(MountCheckpoint) == 32,
+               "MountCheckpoint must be 32 bytes");
+
+/**
+ * @brief Largest program unit Fcb.align may ask for.
+ */
+#define FCB_ALIGN_MAX 64
+
+/* A checkpoint slot fits in a buffer of the largest program unit */
+_Static_assert(sizeof(MountCheckpoint) <= FCB_ALIGN_MAX,
+               "MountCheckpoint must fit in FCB_ALIGN_MAX");
 
 /*============================================================================
  * Private Function Prototypes
  *============================================================================*/
 
-static uint32_t fcb_get_sector_status(uint32_t sector_num,
+static const uint8_t *fcb_flash_map(const Fcb *fcb, uint32_t addr,
+                                    uint32_t len);
+static int fcb_flash_read(const Fcb *fcb, uint32_t addr, void *data,
+                          uint32_t len);
+static uint32_t fcb_align_up(const Fcb *fcb, uint32_t n);
+static uint32_t fcb_item_size(const Fcb *fcb, uint32_t len);
+static uint32_t fcb_data_start(const Fcb *fcb);
+static uint32_t fcb_summary_offset(const Fcb *fcb);
+static int fcb_read_summary(const Fcb *fcb, uint32_t sector_num,
+                            SectorSummary *summary);
+static void fcb_seal_sector(Fcb *fcb, uint32_t sector_num, uint32_t end);
+static uint32_t fcb_ckpt_size(const Fcb *fcb);
+static int fcb_ckpt_slot_is_free(const Fcb *fcb, uint32_t addr);
+static int fcb_ckpt_latest(const Fcb *fcb, uint32_t sector_num,
+                           MountCheckpoint *ckpt, uint32_t *free_out);
+static int fcb_ckpt_load(Fcb *fcb, MountCheckpoint *ckpt);
+static int fcb_ckpt_pos_ok(const Fcb *fcb, uint32_t addr);
+static int fcb_mount_checkpoint(Fcb *fcb);
+static uint16_t fcb_lz_pack(Fcb *fcb, const void **data, uint16_t *len);
+static uint32_t fcb_crc32(uint32_t crc, const void *data, size_t len);
+static int fcb_flash_program(Fcb *fcb, uint32_t addr, const void *data,
+                             uint32_t len);
+static int fcb_flash_write(Fcb *fcb, uint32_t addr, const void *data,
+                           uint32_t len);
+static int fcb_flash_erase(Fcb *fcb, uint32_t sector_num);
+static uint32_t fcb_sector_shift(uint32_t sector_size);
+static uint32_t fcb_addr_sector(const Fcb *fcb, uint32_t addr);
+static uint32_t fcb_addr_offset(const Fcb *fcb, uint32_t addr);
+static int fcb_cache_enabled(const Fcb *fcb);
+static void fcb_cache_reset(Fcb *fcb);
+static void fcb_cache_get(const Fcb *fcb, uint32_t offset, void *data,
+                          uint32_t len);
+static void fcb_cache_put(Fcb *fcb, uint32_t offset, const void *data,
+                          uint32_t len);
+static void fcb_cache_evict(Fcb *fcb);
+static void fcb_cache_insert(Fcb *fcb, uint32_t addr,
+                             const struct ItemKey *key, const FcbIovec *parts,
+                             size_t cnt);
+static int fcb_cache_read(const Fcb *fcb, uint32_t addr, void *data,
+                          uint32_t len);
+static void fcb_cache_update(Fcb *fcb, uint32_t addr, const void *data,
+                             uint32_t len);
+static void fcb_cache_drop_sector(Fcb *fcb, uint32_t sector_num);
+static uint32_t fcb_sector_erase_count(const Fcb *fcb, uint32_t sector_num);
+static int fcb_stamp_erase_count(Fcb *fcb, uint32_t sector_num,
+                                 uint32_t erase_count);
+static void fcb_wear_range(const Fcb *fcb, uint32_t *min_out,
+                           uint32_t *max_out, uint64_t *sum_out);
+static int fcb_sector_is_skipped(const Fcb *fcb, uint32_t sector_num);
+static uint32_t fcb_next_sector(const Fcb *fcb, uint32_t sector_num);
+static uint32_t fcb_pick_sector(Fcb *fcb, uint32_t next_sector,
+                                uint32_t tail_sector);
+static uint32_t fcb_get_sector_status(const Fcb *fcb, uint32_t sector_num,
                                       SectorHeader *header);
 static void fcb_append_sector(Fcb *fcb, uint32_t sector_num);
 static void fcb_find_head_tail(Fcb *fcb, int *head_out, int *tail_out,
                                uint32_t *highest_seq_out);
-static uint32_t fcb_find_sector_head_offset(uint32_t sector_num);
-static uint32_t fcb_find_sector_tail_offset(uint32_t sector_num);
-static uint32_t fcb_recover_global_tail(Fcb *fcb, uint32_t head_addr);
-static int fcb_sector_is_empty(uint32_t sector_num);
-static int fcb_read_item_at(uint32_t addr, struct ItemKey *key_out);
+static uint32_t fcb_find_sector_head_offset(const Fcb *fcb,
+                                            uint32_t sector_num,
+                                            uint32_t *torn_out);
+static void fcb_clear_torn(Fcb *fcb, uint32_t sector_num, uint32_t offset,
+                           uint32_t end);
+static uint32_t fcb_find_sector_tail_offset(const Fcb *fcb,
+                                            uint32_t sector_num);
+static int fcb_probe_sector(const Fcb *fcb, uint32_t sector_num,
+                            uint32_t *seq_out);
+static int fcb_search_head_tail(Fcb *fcb, int *head_out, int *tail_out,
+                                uint32_t *highest_seq_out);
+static uint32_t fcb_recover_global_tail(Fcb *fcb, uint32_t head_addr,
+                                        int tail_sector);
+static int fcb_sector_is_empty(const Fcb *fcb, uint32_t sector_num);
+static int fcb_read_item_at(const Fcb *fcb, uint32_t addr,
+                            struct ItemKey *key_out);
+static uint16_t fcb_item_flags(const struct ItemKey *key);
+static void fcb_set_sector_state(Fcb *fcb, uint32_t sector_num,
+                                 uint32_t state);
+static uint32_t fcb_ring_distance(const Fcb *fcb, uint32_t from, uint32_t to);
+static int fcb_locate_item(Fcb *fcb, uint32_t *addr_io,
+                           struct ItemKey *key_out);
+static int fcb_item_is_intact(const Fcb *fcb, uint32_t addr);
+static int fcb_resync(const Fcb *fcb, uint32_t sector_num, uint32_t offset,
+                      uint32_t min_ff, uint32_t *offset_out);
+static void fcb_reclaim_tail(Fcb *fcb, uint32_t tail_sector);
+static int fcb_record_at(const Fcb *fcb, uint32_t sector_num, uint32_t end,
+                         uint32_t *offset_io, struct ItemKey *key_out);
+static uint32_t fcb_count_records(const Fcb *fcb, uint32_t sector_num,
+                                  uint32_t end, uint32_t stop);
+static uint32_t fcb_sector_first_record(const Fcb *fcb, uint32_t sector_num);
+static uint32_t fcb_record_of(const Fcb *fcb, uint32_t addr);
+static void fcb_build_record_index(Fcb *fcb);
+static int fcb_find_record(const Fcb *fcb, uint32_t record, uint32_t *addr_out);
+static int fcb_addr_is_live(const Fcb *fcb, uint32_t addr);
+static void fcb_consume_to(Fcb *fcb, uint32_t limit);
+static int fcb_prepare_write(Fcb *fcb, uint32_t item_size);
+static int fcb_write_item(Fcb *fcb, uint16_t flags, const FcbIovec *parts,
+                          size_t cnt, uint16_t raw_len);
+static FcbKvSlot *fcb_kv_slot(const Fcb *fcb, uint16_t id, int insert);
+static int fcb_kv_id(const Fcb *fcb, uint32_t addr, const struct ItemKey *key,
+                     uint16_t *id_out);
+static void fcb_kv_build(Fcb *fcb);
+static void fcb_kv_drop_sector(Fcb *fcb, uint32_t sector_num);
+static int fcb_kv_copy(Fcb *fcb, uint32_t addr, const struct ItemKey *key,
+                       uint32_t *addr_out);
+static void fcb_kv_collect(Fcb *fcb);
+static void fcb_erase_done(int rc, void *arg);
+static void fcb_collect_erase(Fcb *fcb);
+static int fcb_wb_enabled(const Fcb *fcb);
+static int fcb_wb_commit(Fcb *fcb, uint32_t len);
+static uint32_t fcb_wb_whole_pages(const Fcb *fcb);
+static int fcb_wb_write(Fcb *fcb, uint32_t addr, const void *data,
+                        uint32_t len);
+static int fcb_wb_apply_policy(Fcb *fcb);
+static int fcb_locate_read(Fcb *fcb, FcbItem *item);
+static void fcb_stage_init(const Fcb *fcb, FcbStage *stage);
+static void fcb_stage_program(Fcb *fcb, FcbStage *stage, const void *data,
+                              uint32_t len);
+static void fcb_stage_flush(Fcb *fcb, FcbStage *stage);
+static void fcb_stage_write(Fcb *fcb, FcbStage *stage, const void *data,
+                            uint32_t len);
+static int fcb_export_locate(const Fcb *fcb, FcbExport *exp,
+                             struct ItemKey *key_out);
 
 /*============================================================================
  * Constants
@@ -83,18 +320,40 @@ static int fcb_read_item_at(uint32_t addr, struct ItemKey *key_out);
  */
 #define SECTOR_MAGIC 0xCAFEBABE
 
+/**
+ * @brief Sector summary magic number, marks a sealed sector
+ */
+#define SUMMARY_MAGIC 0x5EA1ED00
+
+/**
+ * @brief Checkpoint magic number, marks a written checkpoint slot
+ */
+#define CHECKPOINT_MAGIC 0xC4EC9017
+
 /**
  * @brief Sector State Machine
  *
  * NOR flash bits can only transition from 1 -> 0 (without erase).
  * The state values are designed so each transition only clears bits:
  *
- *   FRESH (erased) -> ALLOCATED (writing) -> CONSUMED (garbage)
- *   0xFFFFFFFF     -> 0x7FFFFFFF          -> 0x0FFFFFFF
+ *   FRESH (erased) -> ALLOCATED (writing) -> FULL (sealed) -> CONSUMED
+ *   0xFFFFFFFF     -> 0x7FFFFFFF          -> 0x3FFFFFFF    -> 0x0FFFFFFF
+ *
+ * FULL is set right after the SectorSummary is programmed. A sector left
+ * before that (power loss, or an image written before summaries existed)
+ * goes straight from ALLOCATED to CONSUMED.
+ *
+ * With Fcb.wear_skip, a garbage sector that is wearing too fast is left
+ * alone for a lap instead of being erased:
+ *
+ *   ALLOCATED / FULL / CONSUMED -> SKIPPED
+ *                                  0x00FFFFFF
  */
 #define STATE_FRESH 0xFFFFFFFF /**< Erased sector, ready for use */
 #define STATE_ALLOCATED 0x7FFFFFFF /**< Write in progress */
+#define STATE_FULL 0x3FFFFFFF /**< Sealed, holds a SectorSummary */
 #define STATE_CONSUMED 0x0FFFFFFF /**< Garbage, ready for erase */
+#define STATE_SKIPPED 0x00FFFFFF /**< Garbage, excluded from the ring */
 #define STATE_INVALID 0x00000000 /**< Invalid sector header */
 
 /* ============================================================================
@@ -108,10 +367,31 @@ static int fcb_read_item_at(uint32_t addr, struct ItemKey *key_out);
  * Popped (Done):    0x00000000 (All bits cleared)
  */
 #define FCB_ENTRY_MAGIC 0xA55A
+
+/*
+ * Cleared in the magic of an item whose payload is a compressed record
+ * (fcb_lz.h). The low byte, which fcb_resync() looks for, stays the same.
+ */
+#define FCB_KEY_FLAG_LZ 0x0100
+
+/*
+ * Cleared in the magic of a keyed record, whose payload starts with its
+ * 16-bit record ID (little endian), see fcb_put().
+ */
+#define FCB_KEY_FLAG_ID 0x0400
+
+/* Every flag bit an item magic may have cleared */
+#define FCB_KEY_FLAGS (FCB_KEY_FLAG_LZ | FCB_KEY_FLAG_ID)
 #define FCB_STATUS_ERASED 0xFFFFFFFF
 #define FCB_STATUS_VALID 0x0000FFFF
 #define FCB_STATUS_POPPED 0x00000000
 
+/*
+ * Address of an index slot whose ID lost its last record to a sector erase.
+ * Never an item address, and unlike 0 it does not end a probe.
+ */
+#define FCB_KV_DROPPED 0xFFFFFFFF
+
 /*============================================================================
  * Sequence ID Rollover-Safe Comparison Macros
  *============================================================================*/
@@ -133,519 +413,4723 @@ static int fcb_read_item_at(uint32_t addr, struct ItemKey *key_out);
 #define SEQ_IS_OLDER(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
 
 /*============================================================================
- * Public Functions
+ * Background Erase States
+ *============================================================================*/
+
+#define FCB_ERASE_IDLE 0   /**< No background erase in progress */
+#define FCB_ERASE_BUSY 1   /**< Erase started, waiting for completion */
+#define FCB_ERASE_DONE 2   /**< Erase completed, not yet accounted for */
+#define FCB_ERASE_FAILED 3 /**< Erase completed with an error */
+
+/*============================================================================
+ * Recovery Scan Helpers
  *============================================================================*/
 
 /**
- * @brief Write a sector header to the beginning of a flat sector.
+ * @brief Number of bytes read per flash access while resynchronising.
+ */
+#define FCB_SCAN_CHUNK 256
+
+/**
+ * @brief Word-wide byte search (non-zero if any byte of v equals b).
+ */
+#define FCB_HAS_ZERO_BYTE(v) (((v)-0x01010101U) & ~(v) & 0x80808080U)
+#define FCB_HAS_BYTE(v, b) FCB_HAS_ZERO_BYTE((v) ^ (0x01010101U * (b)))
+
+/*============================================================================
+ * Mount Search Probe Results
+ *============================================================================*/
+
+#define FCB_PROBE_EMPTY 0   /**< Erased sector, no header written */
+#define FCB_PROBE_VALID 1   /**< Valid header, sequence_id is meaningful */
+#define FCB_PROBE_CORRUPT 2 /**< Neither erased nor a valid header */
+
+/*============================================================================
+ * Flash Access
+ *============================================================================*/
+
+/**
+ * @brief Continue a CRC32 calculation, timed when FCB_METRICS is enabled.
  *
- * @param sector_num The index of the sector (0 to FLASH_SECTOR_COUNT - 1).
- * @param header Pointer to the SectorHeader structure to be written.
+ * @param crc CRC32 of the preceding data (0 for the first buffer).
+ * @param data Pointer to the buffer.
+ * @param len Length of the data in bytes.
+ * @return uint32_t CRC32 of the preceding data followed by this buffer.
  */
-void fcb_write_sector_header(uint32_t sector_num, SectorHeader *header)
+static uint32_t fcb_crc32(uint32_t crc, const void *data, size_t len)
 {
-  if (sector_num >= FLASH_SECTOR_COUNT || header == NULL)
-  {
-    return;
-  }
-
-  uint32_t sector_addr = sector_num * FLASH_SECTOR_SIZE;
+  FCB_METRIC_BEGIN(crc);
+  crc = crc32_update(crc, data, len);
+  FCB_METRIC_END(FCB_METRIC_CRC, crc);
 
-  /* Write the header to the very beginning of the sector */
-  flash_write(sector_addr, header, sizeof(SectorHeader));
+  return crc;
 }
 
 /**
- * @brief Read a sector header from the beginning of a flat sector.
+ * @brief Access flash contents in place through the mapped device view.
  *
- * @param sector_num The index of the sector (0 to FLASH_SECTOR_COUNT - 1).
- * @param header Pointer to the SectorHeader structure to be populated.
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address.
+ * @param len Number of bytes that will be accessed.
+ * @return const uint8_t* Pointer to the bytes, or NULL if the device is not
+ * memory-mapped or some of them are still held in the write-combining
+ * buffer.
  */
-void fcb_read_sector_header(uint32_t sector_num, SectorHeader *header)
+static const uint8_t *fcb_flash_map(const Fcb *fcb, uint32_t addr,
+                                    uint32_t len)
 {
-  if (sector_num >= FLASH_SECTOR_COUNT || header == NULL)
+  if (fcb->dev->base == NULL)
   {
-    return;
+    return NULL;
   }
 
-  uint32_t sector_addr = sector_num * FLASH_SECTOR_SIZE;
+  if (fcb->wb_len > 0 && addr < fcb->wb_addr + fcb->wb_len &&
+      addr + len > fcb->wb_addr)
+  {
+    return NULL;
+  }
 
-  /* Read the header from the very beginning of the sector */
-  flash_read(sector_addr, header, sizeof(SectorHeader));
+  return fcb->dev->base + addr;
 }
 
 /**
- * @brief Read and validate a sector header status.
+ * @brief Read from the flash device of an FCB instance.
  *
- * @param sector_num The index of the sector (0 to FLASH_SECTOR_COUNT - 1).
- * @param header Pointer to the SectorHeader structure to be populated.
- * @return uint32_t The state value from the header if valid, otherwise
- * STATE_INVALID.
+ * Memory-mapped devices are copied from directly, without a backend call,
+ * and so are items held in the record cache.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address to read from.
+ * @param data Destination buffer.
+ * @param len Number of bytes to read.
+ * @return int 0 on success, negative backend error code otherwise.
  */
-static uint32_t fcb_get_sector_status(uint32_t sector_num,
-                                      SectorHeader *header)
+static int fcb_flash_read(const Fcb *fcb, uint32_t addr, void *data,
+                          uint32_t len)
 {
-  if (sector_num >= FLASH_SECTOR_COUNT || header == NULL)
+  const uint8_t *mapped = fcb_flash_map(fcb, addr, len);
+  if (mapped != NULL)
   {
-    return STATE_INVALID;
+    memcpy(data, mapped, len);
+    return 0;
   }
 
-  fcb_read_sector_header(sector_num, header);
+  if (fcb_cache_enabled(fcb))
+  {
+    if (fcb_cache_read(fcb, addr, data, len) == 0)
+    {
+      FCB_METRIC_ADD(cache_hits, 1);
+      return 0;
+    }
+
+    FCB_METRIC_ADD(cache_misses, 1);
+  }
 
-  /* Validate header integrity */
-  if (header->magic != SECTOR_MAGIC)
+  FCB_METRIC_ADD(reads, 1);
+
+  int rc = fcb->dev->ops->read(fcb->dev->ctx, addr, data, len);
+  if (rc != 0 || fcb->wb_len == 0)
   {
-    return STATE_INVALID;
+    return rc;
   }
 
-  uint32_t calculated_crc = crc32_gen(header, 8);
-  if (calculated_crc != header->header_crc)
+  /* Bytes still held in the write-combining buffer override the flash */
+  uint32_t wb_end = fcb->wb_addr + fcb->wb_len;
+  uint32_t start = (addr > fcb->wb_addr) ? addr : fcb->wb_addr;
+  uint32_t end = (addr + len < wb_end) ? addr + len : wb_end;
+  if (start < end)
   {
-    return STATE_INVALID;
+    memcpy((uint8_t *)data + (start - addr), &fcb->wb_buf[start - fcb->wb_addr],
+           end - start);
   }
 
-  return header->state;
+  return 0;
 }
 
 /**
- * @brief Reserve the next sector by writing an ALLOCATED header.
+ * @brief Program the flash device of an FCB instance.
+ *
+ * The write is split so that no program operation crosses a page boundary.
  *
  * @param fcb Pointer to the FCB logistics structure.
- * @param sector_num The index of the sector to be reserved.
+ * @param addr Absolute device address to write to.
+ * @param data Source data buffer.
+ * @param len Number of bytes to write.
+ * @return int 0 on success, negative backend error code otherwise.
  */
-static void fcb_append_sector(Fcb *fcb, uint32_t sector_num)
+static int fcb_flash_program(Fcb *fcb, uint32_t addr, const void *data,
+                             uint32_t len)
 {
-  if (fcb == NULL || sector_num >= FLASH_SECTOR_COUNT)
-  {
-    return;
-  }
+  const uint8_t *src = (const uint8_t *)data;
+  uint32_t page_size = fcb->dev->page_size;
 
-  SectorHeader header;
-  memset(&header, 0, sizeof(SectorHeader));
+  fcb->stat_programmed += len;
 
-  fcb->current_sector_id++;
+  while (len > 0)
+  {
+    uint32_t chunk = page_size - (addr % page_size);
+    if (chunk > len)
+    {
+      chunk = len;
+    }
 
-  header.magic = SECTOR_MAGIC;
-  header.sequence_id = fcb->current_sector_id;
-  header.state = STATE_ALLOCATED;
+    FCB_METRIC_BEGIN(program);
+    int rc = fcb->dev->ops->program(fcb->dev->ctx, addr, src, chunk);
+    FCB_METRIC_END(FCB_METRIC_FLASH_WRITE, program);
+    FCB_METRIC_ADD(bytes_programmed, chunk);
+    if (rc != 0)
+    {
+      /* The cache may hold bytes that never made it to flash */
+      fcb_cache_reset(fcb);
+      return rc;
+    }
 
-  /* Calculate CRC32 over magic and sequence_id (8 bytes) */
-  header.header_crc = crc32_gen(&header, 8);
+    addr += chunk;
+    src += chunk;
+    len -= chunk;
+  }
 
-  /* Write the header to the beginning of the sector */
-  fcb_write_sector_header(sector_num, &header);
+  return 0;
 }
 
 /**
- * @brief Scan the FCB sectors to find the newest and oldest sectors.
+ * @brief Update flash contents that may still be held in RAM.
+ *
+ * Used for in-place updates (status words, sector headers). Bytes that fall
+ * into the write-combining buffer are cleared there, as the flash itself
+ * would, and reach the device with the next flush; the rest is programmed.
  *
  * @param fcb Pointer to the FCB logistics structure.
- * @param head_out Pointer to store the index of the newest sector.
- * @param tail_out Pointer to store the index of the oldest sector.
- * @param highest_seq_out Pointer to store the highest sequence ID found.
+ * @param addr Absolute device address to write to.
+ * @param data Source data buffer.
+ * @param len Number of bytes to write.
+ * @return int 0 on success, negative backend error code otherwise.
  */
-static void fcb_find_head_tail(Fcb *fcb, int *head_out, int *tail_out,
-                               uint32_t *highest_seq_out)
+static int fcb_flash_write(Fcb *fcb, uint32_t addr, const void *data,
+                           uint32_t len)
 {
-  uint32_t highest_seq = 0;
-  uint32_t lowest_seq = 0xFFFFFFFF;
-  int head = -1;
-  int tail = -1;
-  SectorHeader header;
+  const uint8_t *src = (const uint8_t *)data;
 
-  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  fcb_cache_update(fcb, addr, data, len);
+
+  if (fcb->wb_len > 0 && addr + len > fcb->wb_addr &&
+      addr < fcb->wb_addr + fcb->wb_len)
   {
-    uint32_t state = fcb_get_sector_status(i, &header);
+    uint32_t wb_end = fcb->wb_addr + fcb->wb_len;
+    uint32_t start = (addr > fcb->wb_addr) ? addr : fcb->wb_addr;
+    uint32_t end = (addr + len < wb_end) ? addr + len : wb_end;
 
-    /* Skip invalid or erased sectors */
-    if (state == STATE_INVALID || state == STATE_FRESH)
+    for (uint32_t a = start; a < end; a++)
     {
-      continue;
+      fcb->wb_buf[a - fcb->wb_addr] &= src[a - addr];
     }
 
-    /* Track the newest sector (highest sequence ID) */
-    if (head == -1 || SEQ_IS_NEWER(header.sequence_id, highest_seq))
+    /* Program whatever lies before or after the buffered range */
+    int rc = 0;
+    if (addr < start)
     {
-      highest_seq = header.sequence_id;
-      head = (int)i;
+      rc = fcb_flash_program(fcb, addr, src, start - addr);
     }
-
-    /* Track the oldest sector (lowest sequence ID) */
-    if (tail == -1 || SEQ_IS_OLDER(header.sequence_id, lowest_seq))
+    if (rc == 0 && end < addr + len)
     {
-      lowest_seq = header.sequence_id;
-      tail = (int)i;
+      rc = fcb_flash_program(fcb, end, src + (end - addr), addr + len - end);
     }
+
+    return rc;
   }
 
-  *head_out = head;
-  *tail_out = tail;
-  *highest_seq_out = highest_seq;
+  return fcb_flash_program(fcb, addr, data, len);
+}
+
+/*============================================================================
+ * Record Cache
+ *
+ * Fcb.cache_buf mirrors the items last appended, ItemKey and stored payload,
+ * so that reads of the newest records are served from RAM. Later updates
+ * of the flash (status words) are applied to the copies as well, erases
+ * and failed programs drop them.
+ *============================================================================*/
+
+/**
+ * @brief Check whether the record cache is in use.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 1 if reads may be served from cache_buf, 0 otherwise.
+ */
+static int fcb_cache_enabled(const Fcb *fcb)
+{
+  return fcb->cache_buf != NULL &&
+         fcb->cache_size > sizeof(FcbCacheEntry) + sizeof(struct ItemKey) &&
+         fcb->dev->base == NULL;
 }
 
 /**
- * @brief Read an FCB item (header and optionally data) from a specific address.
+ * @brief Drop every cached item.
  *
- * @param addr The absolute flash address to read from.
- * @param key_out Pointer to store the read ItemKey.
- * @return int 0 on success, negative error code otherwise.
+ * @param fcb Pointer to the FCB logistics structure.
  */
-static int fcb_read_item_at(uint32_t addr, struct ItemKey *key_out)
+static void fcb_cache_reset(Fcb *fcb)
 {
-  if (key_out == NULL)
+  fcb->cache_head = 0;
+  fcb->cache_used = 0;
+  fcb->cache_count = 0;
+}
+
+/**
+ * @brief Copy bytes out of the cache ring.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param offset Ring offset of the first byte, may be past the end.
+ * @param data Destination buffer.
+ * @param len Number of bytes to copy.
+ */
+static void fcb_cache_get(const Fcb *fcb, uint32_t offset, void *data,
+                          uint32_t len)
+{
+  offset %= fcb->cache_size;
+
+  uint32_t first = fcb->cache_size - offset;
+  first = (first < len) ? first : len;
+  memcpy(data, &fcb->cache_buf[offset], first);
+  memcpy((uint8_t *)data + first, fcb->cache_buf, len - first);
+}
+
+/**
+ * @brief Copy bytes into the cache ring.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param offset Ring offset of the first byte, may be past the end.
+ * @param data Source buffer.
+ * @param len Number of bytes to copy.
+ */
+static void fcb_cache_put(Fcb *fcb, uint32_t offset, const void *data,
+                          uint32_t len)
+{
+  offset %= fcb->cache_size;
+
+  uint32_t first = fcb->cache_size - offset;
+  first = (first < len) ? first : len;
+  memcpy(&fcb->cache_buf[offset], data, first);
+  memcpy(fcb->cache_buf, (const uint8_t *)data + first, len - first);
+}
+
+/**
+ * @brief Drop the oldest cached item.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ */
+static void fcb_cache_evict(Fcb *fcb)
+{
+  FcbCacheEntry entry;
+  fcb_cache_get(fcb, fcb->cache_head, &entry, sizeof(entry));
+
+  uint32_t size = sizeof(entry) + entry.len;
+  fcb->cache_head = (fcb->cache_head + size) % fcb->cache_size;
+  fcb->cache_used -= size;
+  fcb->cache_count--;
+}
+
+/**
+ * @brief Add an item being appended, evicting the oldest ones for room.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Flash address of the item's ItemKey.
+ * @param key The ItemKey of the item.
+ * @param parts Payload pieces, as stored back to back.
+ * @param cnt Number of pieces.
+ */
+static void fcb_cache_insert(Fcb *fcb, uint32_t addr,
+                             const struct ItemKey *key, const FcbIovec *parts,
+                             size_t cnt)
+{
+  if (!fcb_cache_enabled(fcb))
   {
-    return -1;
+    return;
   }
 
-  /* Read the item header */
-  flash_read(addr, key_out, sizeof(struct ItemKey));
+  FcbCacheEntry entry;
+  entry.addr = addr;
+  entry.len = sizeof(struct ItemKey) + key->len;
 
-  /* Validate the header */
-  if (key_out->magic != FCB_ENTRY_MAGIC)
+  uint32_t size = sizeof(entry) + entry.len;
+  if (size > fcb->cache_size)
   {
-    return -2;
+    return;
   }
 
-  if (key_out->status == FCB_STATUS_ERASED)
+  /* Lookups rely on the items following each other in ring order */
+  if (fcb->cache_count > 0)
   {
-    return -3;
+    FcbCacheEntry oldest;
+    fcb_cache_get(fcb, fcb->cache_head, &oldest, sizeof(oldest));
+    if (fcb_ring_distance(fcb, oldest.addr, addr) <
+        fcb_ring_distance(fcb, oldest.addr, fcb->cache_end))
+    {
+      fcb_cache_reset(fcb);
+    }
   }
 
-  return 0;
+  while (fcb->cache_used + size > fcb->cache_size)
+  {
+    fcb_cache_evict(fcb);
+  }
+
+  uint32_t offset = fcb->cache_head + fcb->cache_used;
+  fcb_cache_put(fcb, offset, &entry, sizeof(entry));
+  offset += sizeof(entry);
+  fcb_cache_put(fcb, offset, key, sizeof(struct ItemKey));
+  offset += sizeof(struct ItemKey);
+  for (size_t i = 0; i < cnt; i++)
+  {
+    fcb_cache_put(fcb, offset, parts[i].iov_base, parts[i].iov_len);
+    offset += parts[i].iov_len;
+  }
+
+  fcb->cache_used += size;
+  fcb->cache_count++;
+  fcb->cache_end = addr + entry.len;
 }
 
 /**
- * @brief Check if a sector contains any valid data items.
+ * @brief Serve a read from the cache.
  *
- * @param sector_num The index of the sector to check.
- * @return int 1 if empty, 0 otherwise.
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address to read from.
+ * @param data Destination buffer.
+ * @param len Number of bytes to read.
+ * @return int 0 if the bytes lie within one cached item and were copied, -2
+ * otherwise.
  */
-static int fcb_sector_is_empty(uint32_t sector_num)
+static int fcb_cache_read(const Fcb *fcb, uint32_t addr, void *data,
+                          uint32_t len)
 {
-  SectorHeader header;
-  uint32_t state = fcb_get_sector_status(sector_num, &header);
-
-  /* If header is invalid or sector is fresh (all FF), it's empty */
-  if (state == STATE_INVALID || state == STATE_FRESH)
+  if (fcb->cache_count == 0)
   {
-    return 1;
+    return -2;
   }
 
-  uint32_t data_addr = sector_num * FLASH_SECTOR_SIZE + sizeof(SectorHeader);
-  struct ItemKey key;
+  FcbCacheEntry entry;
+  uint32_t offset = fcb->cache_head;
+  fcb_cache_get(fcb, offset, &entry, sizeof(entry));
 
-  /* Header is valid, now check the first item's magic */
-  fcb_read_item_at(data_addr, &key);
+  /* Outside the flash span of the cached items */
+  if (fcb_ring_distance(fcb, entry.addr, addr) >=
+      fcb_ring_distance(fcb, entry.addr, fcb->cache_end))
+  {
+    return -2;
+  }
 
-  /* If the first item's magic is 0xFFFF, no items have been written yet */
-  if (key.magic == 0xFFFF)
+  for (uint32_t i = 0; i < fcb->cache_count; i++)
   {
-    return 1;
+    fcb_cache_get(fcb, offset, &entry, sizeof(entry));
+    if (addr >= entry.addr && addr + len <= entry.addr + entry.len)
+    {
+      fcb_cache_get(fcb, offset + sizeof(entry) + (addr - entry.addr), data,
+                    len);
+      return 0;
+    }
+
+    offset += sizeof(entry) + entry.len;
   }
 
-  /* Valid header and at least one valid item magic (or at least not FF) */
-  return 0;
+  return -2;
 }
 
 /**
- * @brief Find the first available write position (head) in a sector.
- *
- * Scans for the first FF space of at least 2*sizeof(ItemKey).
+ * @brief Apply an in-place flash update to the cached copies.
  *
- * @param sector_num The index of the sector to scan.
- * @return uint32_t The next sector-relative write offset, or 0xFFFFFFFF if
- * full.
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address being programmed.
+ * @param data Bytes being programmed.
+ * @param len Number of bytes.
  */
-static uint32_t fcb_find_sector_head_offset(uint32_t sector_num)
+static void fcb_cache_update(Fcb *fcb, uint32_t addr, const void *data,
+                             uint32_t len)
 {
-  uint32_t sector_addr = sector_num * FLASH_SECTOR_SIZE;
-  uint32_t offset = sizeof(SectorHeader);
-  uint32_t threshold = 2 * sizeof(struct ItemKey);
-
-  while (offset + threshold <= FLASH_SECTOR_SIZE)
+  if (!fcb_cache_enabled(fcb) || fcb->cache_count == 0)
   {
-    uint32_t word;
-    flash_read(sector_addr + offset, &word, sizeof(word));
+    return;
+  }
 
-    if (word == 0xFFFFFFFF)
+  const uint8_t *src = (const uint8_t *)data;
+  uint32_t offset = fcb->cache_head;
+  FcbCacheEntry entry;
+
+  /* Appends program past the newest cached item, nothing to update */
+  fcb_cache_get(fcb, offset, &entry, sizeof(entry));
+  uint32_t span = fcb_ring_distance(fcb, entry.addr, fcb->cache_end);
+  if (fcb_ring_distance(fcb, entry.addr, addr) >= span &&
+      fcb_ring_distance(fcb, entry.addr, addr + len - 1) >= span)
+  {
+    return;
+  }
+
+  for (uint32_t i = 0; i < fcb->cache_count; i++)
+  {
+    fcb_cache_get(fcb, offset, &entry, sizeof(entry));
+
+    uint32_t start = (addr > entry.addr) ? addr : entry.addr;
+    uint32_t end = (addr + len < entry.addr + entry.len)
+                       ? addr + len
+                       : entry.addr + entry.len;
+
+    /* Programming only clears bits, as the flash does */
+    for (uint32_t a = start; a < end; a++)
+    {
+      uint32_t at = (offset + sizeof(entry) + (a - entry.addr)) %
+                    fcb->cache_size;
+      fcb->cache_buf[at] &= src[a - addr];
+    }
+
+    offset += sizeof(entry) + entry.len;
+  }
+}
+
+/**
+ * @brief Drop the cached items of a sector about to be erased.
+ *
+ * The items of a sector are older than those of the sectors written after
+ * it, so everything up to its last cached item goes.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ */
+static void fcb_cache_drop_sector(Fcb *fcb, uint32_t sector_num)
+{
+  if (!fcb_cache_enabled(fcb))
+  {
+    return;
+  }
+
+  uint32_t drop = 0;
+  uint32_t offset = fcb->cache_head;
+
+  for (uint32_t i = 0; i < fcb->cache_count; i++)
+  {
+    FcbCacheEntry entry;
+    fcb_cache_get(fcb, offset, &entry, sizeof(entry));
+    if (fcb_addr_sector(fcb, entry.addr) == sector_num)
+    {
+      drop = i + 1;
+    }
+
+    offset += sizeof(entry) + entry.len;
+  }
+
+  while (drop-- > 0)
+  {
+    fcb_cache_evict(fcb);
+  }
+}
+
+/**
+ * @brief Shift that replaces the sector size divisions, see Fcb.sector_shift.
+ *
+ * @param sector_size Size of each sector in bytes.
+ * @return uint32_t log2(sector_size) if it is a power of two, 0 otherwise.
+ */
+static uint32_t fcb_sector_shift(uint32_t sector_size)
+{
+  if (sector_size == 0 || (sector_size & (sector_size - 1)) != 0)
+  {
+    return 0;
+  }
+
+  uint32_t shift = 0;
+  while ((1u << shift) < sector_size)
+  {
+    shift++;
+  }
+
+  return shift;
+}
+
+/**
+ * @brief Sector holding an absolute address.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address.
+ * @return uint32_t The index of the sector.
+ */
+static uint32_t fcb_addr_sector(const Fcb *fcb, uint32_t addr)
+{
+  return (fcb->sector_shift != 0) ? addr >> fcb->sector_shift
+                                  : addr / fcb->sector_size;
+}
+
+/**
+ * @brief Sector-relative offset of an absolute address.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address.
+ * @return uint32_t The offset of addr within its sector.
+ */
+static uint32_t fcb_addr_offset(const Fcb *fcb, uint32_t addr)
+{
+  return (fcb->sector_shift != 0) ? addr & (fcb->sector_size - 1)
+                                  : addr % fcb->sector_size;
+}
+
+/**
+ * @brief Check that a sector index belongs to this FCB instance.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @return int 1 if the sector is part of the FCB, 0 otherwise.
+ */
+static int fcb_sector_in_range(const Fcb *fcb, uint32_t sector_num)
+{
+  return sector_num >= fcb->first_sector && sector_num <= fcb->last_sector;
+}
+
+/**
+ * @brief Round a size or address up to the program unit of the instance.
+ *
+ * Sectors start on unit boundaries, so absolute and sector-relative values
+ * round alike.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param n Value to round.
+ * @return uint32_t n rounded up to a multiple of Fcb.align.
+ */
+static uint32_t fcb_align_up(const Fcb *fcb, uint32_t n)
+{
+  uint32_t mask = (fcb->align > 1) ? fcb->align - 1 : 0;
+
+  return (n + mask) & ~mask;
+}
+
+/**
+ * @brief Flash space taken by an item, padding included.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param len Payload length in bytes.
+ * @return uint32_t Distance from this ItemKey to the next one.
+ */
+static uint32_t fcb_item_size(const Fcb *fcb, uint32_t len)
+{
+  return fcb_align_up(fcb, sizeof(struct ItemKey) + len);
+}
+
+/**
+ * @brief Sector-relative offset of the SectorSummary of a sector.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return uint32_t The first program unit boundary after the SectorHeader.
+ */
+static uint32_t fcb_summary_offset(const Fcb *fcb)
+{
+  return fcb_align_up(fcb, sizeof(SectorHeader));
+}
+
+/**
+ * @brief Sector-relative offset of the first item of a sector.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return uint32_t The first program unit boundary after the SectorSummary.
+ */
+static uint32_t fcb_data_start(const Fcb *fcb)
+{
+  return fcb_align_up(fcb, fcb_summary_offset(fcb) + sizeof(SectorSummary));
+}
+
+/**
+ * @brief Validate the partition geometry against the flash device.
+ *
+ * Sectors are addressed as sector_num * sector_size on the device, so the
+ * whole [first_sector, last_sector] range and the checkpoint sectors after
+ * it must fit in the device and every
+ * sector must be made of whole erase blocks. The program unit must be a
+ * power of two that divides the device page.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 if the geometry is usable, -1 otherwise.
+ */
+static int fcb_check_geometry(const Fcb *fcb)
+{
+  const FlashDev *dev = fcb->dev;
+
+  if (dev->ops == NULL || dev->page_size == 0 || dev->erase_size == 0)
+  {
+    return -1;
+  }
+
+  if (fcb->align > FCB_ALIGN_MAX || (fcb->align & (fcb->align - 1)) != 0 ||
+      (fcb->align > 1 && (dev->page_size % fcb->align != 0 ||
+                          fcb->sector_size % fcb->align != 0)))
+  {
+    return -1;
+  }
+
+  if (fcb->sector_size % dev->erase_size != 0 ||
+      fcb->sector_size <= fcb_data_start(fcb) + fcb_item_size(fcb, 0))
+  {
+    return -1;
+  }
+
+  if (fcb->first_sector > fcb->last_sector || fcb->ckpt_sectors > 2 ||
+      (uint64_t)(fcb->last_sector + 1 + fcb->ckpt_sectors) *
+              fcb->sector_size >
+          dev->size)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Erase one FCB sector on the flash device.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector to erase.
+ * @return int 0 on success, negative backend error code otherwise.
+ */
+static int fcb_flash_erase(Fcb *fcb, uint32_t sector_num)
+{
+  uint32_t erase_count = fcb_sector_erase_count(fcb, sector_num);
+
+  fcb_cache_drop_sector(fcb, sector_num);
+  fcb_kv_drop_sector(fcb, sector_num);
+
+  FCB_METRIC_BEGIN(erase);
+  int rc = fcb->dev->ops->erase(fcb->dev->ctx, sector_num * fcb->sector_size,
+                                fcb->sector_size);
+  FCB_METRIC_END(FCB_METRIC_ERASE, erase);
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  fcb->stat_erases++;
+
+  return fcb_stamp_erase_count(fcb, sector_num, erase_count + 1);
+}
+
+/**
+ * @brief Read the erase counter kept in a sector header.
+ *
+ * Accepts complete headers as well as the magic and counter stamped right
+ * after an erase.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @return uint32_t The erase count, 0 if the sector has none.
+ */
+static uint32_t fcb_sector_erase_count(const Fcb *fcb, uint32_t sector_num)
+{
+  SectorHeader header;
+  fcb_flash_read(fcb, sector_num * fcb->sector_size, &header,
+                 sizeof(SectorHeader));
+
+  if (header.magic != SECTOR_MAGIC)
+  {
+    return 0;
+  }
+
+  if (header.sequence_id == 0xFFFFFFFF && header.header_crc == 0xFFFFFFFF)
+  {
+    /* Freshly erased, only the counter has been stamped */
+    return header.erase_count;
+  }
+
+  if (fcb_crc32(0, &header, offsetof(SectorHeader, header_crc)) !=
+      header.header_crc)
+  {
+    return 0;
+  }
+
+  return header.erase_count;
+}
+
+/**
+ * @brief Carry the erase counter over to a freshly erased sector.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the erased sector.
+ * @param erase_count The new erase count.
+ * @return int 0 on success, negative backend error code otherwise.
+ */
+static int fcb_stamp_erase_count(Fcb *fcb, uint32_t sector_num,
+                                 uint32_t erase_count)
+{
+  SectorHeader header;
+  memset(&header, 0xFF, sizeof(SectorHeader));
+
+  header.magic = SECTOR_MAGIC;
+  header.erase_count = erase_count;
+
+  return fcb_flash_write(fcb, sector_num * fcb->sector_size, &header,
+                         offsetof(SectorHeader, header_crc));
+}
+
+/*============================================================================
+ * Wear Tracking
+ *
+ * Every sector header carries an erase counter. With Fcb.wear_skip set, a
+ * garbage sector erased noticeably more often than the least worn one is
+ * marked STATE_SKIPPED on rollover and left out of the ring for a lap.
+ *============================================================================*/
+
+/**
+ * @brief Sector following another one in ring order.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @return uint32_t The index of the next sector.
+ */
+static uint32_t fcb_next_sector(const Fcb *fcb, uint32_t sector_num)
+{
+  return (sector_num >= fcb->last_sector) ? fcb->first_sector : sector_num + 1;
+}
+
+/**
+ * @brief Check whether a sector is passed over for wear.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @return int 1 if the sector is marked STATE_SKIPPED, 0 otherwise.
+ */
+static int fcb_sector_is_skipped(const Fcb *fcb, uint32_t sector_num)
+{
+  SectorHeader header;
+
+  return fcb_get_sector_status(fcb, sector_num, &header) == STATE_SKIPPED;
+}
+
+/**
+ * @brief Collect the erase counts of all sectors.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param min_out Pointer to store the lowest count, or NULL.
+ * @param max_out Pointer to store the highest count, or NULL.
+ * @param sum_out Pointer to store the sum of all counts, or NULL.
+ */
+static void fcb_wear_range(const Fcb *fcb, uint32_t *min_out,
+                           uint32_t *max_out, uint64_t *sum_out)
+{
+  uint32_t min_wear = 0xFFFFFFFF;
+  uint32_t max_wear = 0;
+  uint64_t sum = 0;
+
+  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  {
+    uint32_t erase_count = fcb_sector_erase_count(fcb, i);
+
+    min_wear = (erase_count < min_wear) ? erase_count : min_wear;
+    max_wear = (erase_count > max_wear) ? erase_count : max_wear;
+    sum += erase_count;
+  }
+
+  if (min_out != NULL)
+  {
+    *min_out = min_wear;
+  }
+
+  if (max_out != NULL)
+  {
+    *max_out = max_wear;
+  }
+
+  if (sum_out != NULL)
+  {
+    *sum_out = sum;
+  }
+}
+
+/**
+ * @brief Choose the sector to continue writing in on rollover.
+ *
+ * Walks the garbage sectors from next_sector on and marks every one worn
+ * more than Fcb.wear_skip erases above the least worn sector as skipped.
+ * The tail sector is never passed over.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param next_sector The sector right after the write sector.
+ * @param tail_sector The sector holding the delete position.
+ * @return uint32_t The sector to erase and reserve next.
+ */
+static uint32_t fcb_pick_sector(Fcb *fcb, uint32_t next_sector,
+                                uint32_t tail_sector)
+{
+  uint32_t write_sector = fcb_addr_sector(fcb, fcb->write_addr);
+  uint32_t min_wear;
+  fcb_wear_range(fcb, &min_wear, NULL, NULL);
+
+  uint32_t sector_num = next_sector;
+  while (sector_num != tail_sector && sector_num != write_sector)
+  {
+    SectorHeader header;
+    uint32_t state = fcb_get_sector_status(fcb, sector_num, &header);
+
+    /* Erased or unreadable sectors carry no reliable count, use them */
+    if (state == STATE_INVALID || state == STATE_FRESH ||
+        header.erase_count <= min_wear + fcb->wear_skip)
+    {
+      return sector_num;
+    }
+
+    if (state != STATE_SKIPPED)
+    {
+      fcb_set_sector_state(fcb, sector_num, STATE_SKIPPED);
+    }
+
+    sector_num = fcb_next_sector(fcb, sector_num);
+  }
+
+  return (sector_num == tail_sector) ? tail_sector : next_sector;
+}
+
+/*============================================================================
+ * Write-Combining Buffer
+ *
+ * Appended bytes collect in Fcb.wb_buf and are programmed in large blocks.
+ * The buffered range is always contiguous and ends at the write address, so
+ * it never spans a sector boundary (it is flushed on rollover).
+ *============================================================================*/
+
+/**
+ * @brief Check whether appends go through the write-combining buffer.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 1 if buffering is enabled, 0 otherwise.
+ */
+static int fcb_wb_enabled(const Fcb *fcb)
+{
+  return fcb->wb_buf != NULL && fcb->wb_size > 0 &&
+         fcb->durability != FCB_DURABLE_IMMEDIATE;
+}
+
+/**
+ * @brief Program the oldest buffered bytes and drop them from the buffer.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param len Number of bytes to program (at most wb_len).
+ * @return int 0 on success, negative backend error code otherwise.
+ */
+static int fcb_wb_commit(Fcb *fcb, uint32_t len)
+{
+  if (len == 0)
+  {
+    return 0;
+  }
+
+  int rc = fcb_flash_program(fcb, fcb->wb_addr, fcb->wb_buf, len);
+
+  /* Failed bytes are dropped as well, the readers skip broken items */
+  fcb->wb_len -= len;
+  memmove(fcb->wb_buf, &fcb->wb_buf[len], fcb->wb_len);
+  fcb->wb_addr += len;
+
+  if (fcb->wb_len > 0 && fcb->clock != NULL)
+  {
+    fcb->wb_since = fcb->clock();
+  }
+
+  return rc;
+}
+
+/**
+ * @brief Number of buffered bytes that end on a flash page boundary.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return uint32_t Length of the buffered prefix made of complete pages.
+ */
+static uint32_t fcb_wb_whole_pages(const Fcb *fcb)
+{
+  uint32_t end = fcb->wb_addr + fcb->wb_len;
+  uint32_t aligned = end - (end % fcb->dev->page_size);
+
+  return (aligned > fcb->wb_addr) ? aligned - fcb->wb_addr : 0;
+}
+
+/**
+ * @brief Queue bytes for programming at a given flash address.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute device address of the first byte.
+ * @param data Source data buffer.
+ * @param len Number of bytes to queue.
+ * @return int 0 on success, negative backend error code otherwise.
+ */
+static int fcb_wb_write(Fcb *fcb, uint32_t addr, const void *data,
+                        uint32_t len)
+{
+  const uint8_t *src = (const uint8_t *)data;
+  int rc = 0;
+
+  /* Only contiguous bytes can be combined */
+  if (fcb->wb_len > 0 && addr != fcb->wb_addr + fcb->wb_len)
+  {
+    rc = fcb_wb_commit(fcb, fcb->wb_len);
+  }
+
+  while (len > 0)
+  {
+    if (fcb->wb_len == fcb->wb_size)
+    {
+      /* Full: program whole pages, or everything if there are none */
+      uint32_t commit = fcb_wb_whole_pages(fcb);
+      int err = fcb_wb_commit(fcb, (commit > 0) ? commit : fcb->wb_len);
+      rc = (rc != 0) ? rc : err;
+    }
+
+    if (fcb->wb_len == 0)
+    {
+      fcb->wb_addr = addr;
+      if (fcb->clock != NULL)
+      {
+        fcb->wb_since = fcb->clock();
+      }
+    }
+
+    uint32_t chunk = fcb->wb_size - fcb->wb_len;
+    if (chunk > len)
+    {
+      chunk = len;
+    }
+
+    memcpy(&fcb->wb_buf[fcb->wb_len], src, chunk);
+    fcb->wb_len += chunk;
+    addr += chunk;
+    src += chunk;
+    len -= chunk;
+  }
+
+  return rc;
+}
+
+/**
+ * @brief Program buffered bytes as required by the durability policy.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, negative backend error code otherwise.
+ */
+static int fcb_wb_apply_policy(Fcb *fcb)
+{
+  if (fcb->wb_len == 0)
+  {
+    return 0;
+  }
+
+  switch (fcb->durability)
+  {
+  case FCB_DURABLE_PAGE:
+    return fcb_wb_commit(fcb, fcb_wb_whole_pages(fcb));
+
+  case FCB_DURABLE_TIME:
+    if (fcb->clock != NULL &&
+        (uint32_t)(fcb->clock() - fcb->wb_since) >= fcb->wb_max_age)
+    {
+      return fcb_wb_commit(fcb, fcb->wb_len);
+    }
+    return 0;
+
+  case FCB_DURABLE_SIZE:
+    if (fcb->wb_len >= fcb->wb_threshold)
+    {
+      return fcb_wb_commit(fcb, fcb->wb_len);
+    }
+    return 0;
+
+  default:
+    return fcb_wb_commit(fcb, fcb->wb_len);
+  }
+}
+
+/**
+ * @brief Program everything held in the write-combining buffer.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, -1 on invalid arguments, -3 on flash error.
+ */
+int fcb_flush(Fcb *fcb)
+{
+  if (fcb == NULL || fcb->dev == NULL)
+  {
+    return -1;
+  }
+
+  return (fcb_wb_commit(fcb, fcb->wb_len) == 0) ? 0 : -3;
+}
+
+/*============================================================================
+ * Public Functions
+ *============================================================================*/
+
+/**
+ * @brief Write a sector header to the beginning of a flat sector.
+ *
+ * @param sector_num The index of the sector (first_sector to last_sector).
+ * @param header Pointer to the SectorHeader structure to be written.
+ */
+void fcb_write_sector_header(Fcb *fcb, uint32_t sector_num, SectorHeader *header)
+{
+  if (fcb == NULL || !fcb_sector_in_range(fcb, sector_num) || header == NULL)
+  {
+    return;
+  }
+
+  uint32_t sector_addr = sector_num * fcb->sector_size;
+
+  /* Write the header to the very beginning of the sector */
+  fcb_flash_write(fcb, sector_addr, header, sizeof(SectorHeader));
+}
+
+/**
+ * @brief Read a sector header from the beginning of a flat sector.
+ *
+ * @param sector_num The index of the sector (first_sector to last_sector).
+ * @param header Pointer to the SectorHeader structure to be populated.
+ */
+void fcb_read_sector_header(const Fcb *fcb, uint32_t sector_num, SectorHeader *header)
+{
+  if (fcb == NULL || !fcb_sector_in_range(fcb, sector_num) || header == NULL)
+  {
+    return;
+  }
+
+  uint32_t sector_addr = sector_num * fcb->sector_size;
+
+  /* Read the header from the very beginning of the sector */
+  fcb_flash_read(fcb, sector_addr, header, sizeof(SectorHeader));
+}
+
+/**
+ * @brief Read and validate a sector header status.
+ *
+ * @param sector_num The index of the sector (first_sector to last_sector).
+ * @param header Pointer to the SectorHeader structure to be populated.
+ * @return uint32_t The state value from the header if valid, otherwise
+ * STATE_INVALID.
+ */
+static uint32_t fcb_get_sector_status(const Fcb *fcb, uint32_t sector_num,
+                                      SectorHeader *header)
+{
+  if (!fcb_sector_in_range(fcb, sector_num) || header == NULL)
+  {
+    return STATE_INVALID;
+  }
+
+  fcb_read_sector_header(fcb, sector_num, header);
+
+  /* Validate header integrity */
+  if (header->magic != SECTOR_MAGIC)
+  {
+    return STATE_INVALID;
+  }
+
+  uint32_t calculated_crc =
+      fcb_crc32(0, header, offsetof(SectorHeader, header_crc));
+  if (calculated_crc != header->header_crc)
+  {
+    return STATE_INVALID;
+  }
+
+  return header->state;
+}
+
+/**
+ * @brief Reserve the next sector by writing an ALLOCATED header.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector to be reserved.
+ */
+static void fcb_append_sector(Fcb *fcb, uint32_t sector_num)
+{
+  if (fcb == NULL || !fcb_sector_in_range(fcb, sector_num))
+  {
+    return;
+  }
+
+  SectorHeader header;
+  memset(&header, 0, sizeof(SectorHeader));
+
+  fcb->current_sector_id++;
+
+  header.magic = SECTOR_MAGIC;
+  header.sequence_id = fcb->current_sector_id;
+  header.first_record = fcb->next_record;
+  header.erase_count = fcb_sector_erase_count(fcb, sector_num);
+  header.state = STATE_ALLOCATED;
+
+  /* Calculate CRC32 over the fields preceding header_crc */
+  header.header_crc = fcb_crc32(0, &header, offsetof(SectorHeader, header_crc));
+
+  /* Write the header to the beginning of the sector */
+  fcb_write_sector_header(fcb, sector_num, &header);
+
+  if (fcb->record_index != NULL)
+  {
+    fcb->record_index[sector_num - fcb->first_sector] = fcb->next_record;
+  }
+}
+
+/**
+ * @brief Scan all FCB sectors to find the newest and oldest sectors.
+ *
+ * Linear fallback for fcb_search_head_tail() when headers are corrupted.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param head_out Pointer to store the index of the newest sector.
+ * @param tail_out Pointer to store the index of the oldest sector.
+ * @param highest_seq_out Pointer to store the highest sequence ID found.
+ */
+static void fcb_find_head_tail(Fcb *fcb, int *head_out, int *tail_out,
+                               uint32_t *highest_seq_out)
+{
+  uint32_t highest_seq = 0;
+  uint32_t lowest_seq = 0xFFFFFFFF;
+  int head = -1;
+  int tail = -1;
+  SectorHeader header;
+
+  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  {
+    uint32_t state = fcb_get_sector_status(fcb, i, &header);
+
+    /* Skip invalid, erased or stale sectors */
+    if (state == STATE_INVALID || state == STATE_FRESH ||
+        state == STATE_SKIPPED)
+    {
+      continue;
+    }
+
+    /* Track the newest sector (highest sequence ID) */
+    if (head == -1 || SEQ_IS_NEWER(header.sequence_id, highest_seq))
+    {
+      highest_seq = header.sequence_id;
+      head = (int)i;
+    }
+
+    /* Track the oldest sector (lowest sequence ID) */
+    if (tail == -1 || SEQ_IS_OLDER(header.sequence_id, lowest_seq))
+    {
+      lowest_seq = header.sequence_id;
+      tail = (int)i;
+    }
+  }
+
+  *head_out = head;
+  *tail_out = tail;
+  *highest_seq_out = highest_seq;
+}
+
+/**
+ * @brief Classify a sector header for the mount search.
+ *
+ * @param sector_num The index of the sector to probe.
+ * @param seq_out Pointer to store the sequence ID of a valid header.
+ * @return int FCB_PROBE_EMPTY, FCB_PROBE_VALID or FCB_PROBE_CORRUPT.
+ */
+static int fcb_probe_sector(const Fcb *fcb, uint32_t sector_num,
+                            uint32_t *seq_out)
+{
+  SectorHeader header;
+  header.magic = 0;
+
+  uint32_t state = fcb_get_sector_status(fcb, sector_num, &header);
+
+  if (state == STATE_INVALID)
+  {
+    /* Erased, possibly with only the erase counter stamped */
+    int erased = header.magic == 0xFFFFFFFF ||
+                 (header.magic == SECTOR_MAGIC &&
+                  header.sequence_id == 0xFFFFFFFF &&
+                  header.header_crc == 0xFFFFFFFF);
+
+    return erased ? FCB_PROBE_EMPTY : FCB_PROBE_CORRUPT;
+  }
+
+  if (state == STATE_FRESH)
+  {
+    return FCB_PROBE_EMPTY;
+  }
+
+  *seq_out = header.sequence_id;
+  return FCB_PROBE_VALID;
+}
+
+/**
+ * @brief Locate the newest and oldest sectors by binary search.
+ *
+ * Sequence IDs increase by one per reserved sector around the ring, so
+ * starting from the first reserved sector (the anchor) the sectors up to the
+ * head are never older than the anchor and everything after it is either
+ * erased or older. Likewise, following the ring from the head, erased
+ * sectors come first and the tail is the first reserved one. Both
+ * boundaries are found with O(log n) header reads.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param head_out Pointer to store the index of the newest sector.
+ * @param tail_out Pointer to store the index of the oldest sector.
+ * @param highest_seq_out Pointer to store the highest sequence ID found.
+ * @return int 0 on success, -1 if a corrupted header or an inconsistent
+ * sequence was found and a linear scan is required.
+ */
+static int fcb_search_head_tail(Fcb *fcb, int *head_out, int *tail_out,
+                                uint32_t *highest_seq_out)
+{
+  uint32_t sector_count = fcb->last_sector - fcb->first_sector + 1;
+  uint32_t anchor = 0;
+  uint32_t anchor_seq = 0;
+  uint32_t seq = 0;
+
+  /* Anchor on the first reserved sector (skips sectors erased ahead) */
+  for (; anchor < sector_count; anchor++)
+  {
+    int probe = fcb_probe_sector(fcb, fcb->first_sector + anchor, &anchor_seq);
+    if (probe == FCB_PROBE_CORRUPT)
+    {
+      return -1;
+    }
+
+    if (probe == FCB_PROBE_VALID)
+    {
+      break;
+    }
+  }
+
+  if (anchor == sector_count)
+  {
+    /* Nothing reserved yet */
+    *head_out = -1;
+    *tail_out = -1;
+    *highest_seq_out = 0;
+    return 0;
+  }
+
+  /* Head: last sector after the anchor that is not older than the anchor */
+  uint32_t lo = anchor;
+  uint32_t hi = sector_count;
+  uint32_t head_seq = anchor_seq;
+
+  while (hi - lo > 1)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    int probe = fcb_probe_sector(fcb, fcb->first_sector + mid, &seq);
+    if (probe == FCB_PROBE_CORRUPT)
+    {
+      return -1;
+    }
+
+    if (probe == FCB_PROBE_VALID && !SEQ_IS_OLDER(seq, anchor_seq))
+    {
+      lo = mid;
+      head_seq = seq;
+    } else
+    {
+      hi = mid;
+    }
+  }
+
+  if (head_seq - anchor_seq != lo - anchor)
+  {
+    return -1;
+  }
+
+  uint32_t head = lo;
+
+  /* Tail: first reserved sector following the ring from the head */
+  lo = 0;
+  hi = sector_count;
+  uint32_t tail_seq = head_seq;
+
+  while (hi - lo > 1)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint32_t sector_num = fcb->first_sector + (head + mid) % sector_count;
+    int probe = fcb_probe_sector(fcb, sector_num, &seq);
+    if (probe == FCB_PROBE_CORRUPT)
+    {
+      return -1;
+    }
+
+    if (probe == FCB_PROBE_VALID)
+    {
+      hi = mid;
+      tail_seq = seq;
+    } else
+    {
+      lo = mid;
+    }
+  }
+
+  if (head_seq - tail_seq != sector_count - hi)
+  {
+    return -1;
+  }
+
+  *head_out = (int)(fcb->first_sector + head);
+  *tail_out = (int)(fcb->first_sector + (head + hi) % sector_count);
+  *highest_seq_out = head_seq;
+
+  return 0;
+}
+
+/**
+ * @brief Read an FCB item (header and optionally data) from a specific address.
+ *
+ * @param addr The absolute flash address to read from.
+ * @param key_out Pointer to store the read ItemKey.
+ * @return int 0 on success, negative error code otherwise.
+ */
+static int fcb_read_item_at(const Fcb *fcb, uint32_t addr,
+                            struct ItemKey *key_out)
+{
+  if (key_out == NULL)
+  {
+    return -1;
+  }
+
+  /* Read the item header */
+  fcb_flash_read(fcb, addr, key_out, sizeof(struct ItemKey));
+
+  /* Validate the header */
+  if ((key_out->magic | FCB_KEY_FLAGS) != FCB_ENTRY_MAGIC)
+  {
+    return -2;
+  }
+
+  if (key_out->status == FCB_STATUS_ERASED)
+  {
+    return -3;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief FcbItem.flags of an item.
+ *
+ * @param key The ItemKey of the item.
+ * @return uint16_t FCB_ITEM_COMPRESSED and FCB_ITEM_KEYED bits.
+ */
+static uint16_t fcb_item_flags(const struct ItemKey *key)
+{
+  uint16_t flags = 0;
+
+  if ((key->magic & FCB_KEY_FLAG_LZ) == 0)
+  {
+    flags |= FCB_ITEM_COMPRESSED;
+  }
+
+  if ((key->magic & FCB_KEY_FLAG_ID) == 0)
+  {
+    flags |= FCB_ITEM_KEYED;
+  }
+
+  return flags;
+}
+
+/**
+ * @brief Update the lifecycle state of a sector header in place.
+ *
+ * Only valid for transitions that clear bits (see the state machine).
+ *
+ * @param sector_num The index of the sector.
+ * @param state The new state value.
+ */
+static void fcb_set_sector_state(Fcb *fcb, uint32_t sector_num,
+                                 uint32_t state)
+{
+  if (!fcb_sector_in_range(fcb, sector_num))
+  {
+    return;
+  }
+
+  fcb_flash_write(fcb,
+                  sector_num * fcb->sector_size +
+                      offsetof(SectorHeader, state),
+                  &state, sizeof(state));
+}
+
+/**
+ * @brief Distance in bytes from one address to another, following the ring.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param from The absolute start address.
+ * @param to The absolute end address.
+ * @return uint32_t Number of bytes between the two addresses.
+ */
+static uint32_t fcb_ring_distance(const Fcb *fcb, uint32_t from, uint32_t to)
+{
+  uint32_t ring_size =
+      (fcb->last_sector - fcb->first_sector + 1) * fcb->sector_size;
+
+  return (to >= from) ? (to - from) : (ring_size - (from - to));
+}
+
+/**
+ * @brief Find the next unconsumed item at or after a given address.
+ *
+ * Items are visited in write order, crossing sector boundaries, until the
+ * write address is reached. Popped items are skipped.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr_io In: absolute address to start from. Out: address of the item
+ * found, or the write address if there is none.
+ * @param key_out Pointer to store the ItemKey of the item found.
+ * @return int 0 if an item was found, -2 otherwise.
+ */
+static int fcb_locate_item(Fcb *fcb, uint32_t *addr_io,
+                           struct ItemKey *key_out)
+{
+  uint32_t write_sector = fcb_addr_sector(fcb, fcb->write_addr);
+  uint32_t addr = *addr_io;
+
+  while (addr != fcb->write_addr)
+  {
+    uint32_t sector_num = fcb_addr_sector(fcb, addr);
+    uint32_t offset = fcb_addr_offset(fcb, addr);
+
+    if (sector_num == write_sector && addr > fcb->write_addr)
+    {
+      /* Overshot the head (corrupted length), nothing left to read */
+      break;
+    }
+
+    if (offset + sizeof(struct ItemKey) <= fcb->sector_size &&
+        fcb_read_item_at(fcb, addr, key_out) == 0 &&
+        offset + sizeof(struct ItemKey) + key_out->len <= fcb->sector_size)
+    {
+      if (key_out->status != FCB_STATUS_POPPED)
+      {
+        *addr_io = addr;
+        return 0;
+      }
+
+      addr += fcb_item_size(fcb, key_out->len);
+      continue;
+    }
+
+    /* Erased space or corrupted data, look for the next intact item */
+    uint32_t min_ff = (sector_num == write_sector) ? 2 * sizeof(struct ItemKey)
+                                                   : sizeof(uint32_t);
+    uint32_t found;
+    SectorSummary summary;
+
+    /* Past the last item of a sealed sector there is nothing to scan */
+    int sealed_end = sector_num != write_sector &&
+                     fcb_read_summary(fcb, sector_num, &summary) == 0 &&
+                     offset >= summary.used;
+
+    if (!sealed_end &&
+        fcb_resync(fcb, sector_num, offset, min_ff, &found) == 1)
+    {
+      addr = sector_num * fcb->sector_size + found;
+      continue;
+    }
+
+    if (sector_num == write_sector)
+    {
+      /* Only erased space left before the head */
+      break;
+    }
+
+    /* End of data in this sector, continue in the next one in use */
+    uint32_t next_sector = fcb_next_sector(fcb, sector_num);
+    while (next_sector != write_sector && fcb_sector_is_skipped(fcb, next_sector))
+    {
+      next_sector = fcb_next_sector(fcb, next_sector);
+    }
+
+    addr = next_sector * fcb->sector_size + fcb_data_start(fcb);
+  }
+
+  *addr_io = fcb->write_addr;
+  return -2;
+}
+
+/**
+ * @brief Check if a sector contains any valid data items.
+ *
+ * @param sector_num The index of the sector to check.
+ * @return int 1 if empty, 0 otherwise.
+ */
+static int fcb_sector_is_empty(const Fcb *fcb, uint32_t sector_num)
+{
+  SectorHeader header;
+  uint32_t state = fcb_get_sector_status(fcb, sector_num, &header);
+
+  /* If header is invalid or sector is fresh (all FF), it's empty */
+  if (state == STATE_INVALID || state == STATE_FRESH)
+  {
+    return 1;
+  }
+
+  uint32_t data_addr = sector_num * fcb->sector_size + fcb_data_start(fcb);
+  struct ItemKey key;
+
+  /* Header is valid, now check the first item's magic */
+  fcb_read_item_at(fcb, data_addr, &key);
+
+  /* If the first item's magic is 0xFFFF, no items have been written yet */
+  if (key.magic == 0xFFFF)
+  {
+    return 1;
+  }
+
+  /* Valid header and at least one valid item magic (or at least not FF) */
+  return 0;
+}
+
+/**
+ * @brief Check that an item is complete, including its payload CRC.
+ *
+ * @param addr The absolute flash address of the ItemKey.
+ * @return int 1 if the item is intact, 0 otherwise.
+ */
+static int fcb_item_is_intact(const Fcb *fcb, uint32_t addr)
+{
+  struct ItemKey key;
+  uint32_t offset = fcb_addr_offset(fcb, addr);
+
+  if (offset + sizeof(struct ItemKey) > fcb->sector_size ||
+      fcb_read_item_at(fcb, addr, &key) != 0 ||
+      offset + sizeof(struct ItemKey) + key.len > fcb->sector_size)
+  {
+    return 0;
+  }
+
+  uint32_t data_addr = addr + sizeof(struct ItemKey);
+  const uint8_t *mapped = fcb_flash_map(fcb, data_addr, key.len);
+  if (mapped != NULL)
+  {
+    return fcb_crc32(0, mapped, key.len) == key.crc;
+  }
+
+  uint8_t buf[FCB_SCAN_CHUNK];
+  uint32_t remaining = key.len;
+  uint32_t crc = 0;
+
+  while (remaining > 0)
+  {
+    uint32_t chunk = (remaining < sizeof(buf)) ? remaining : sizeof(buf);
+    fcb_flash_read(fcb, data_addr, buf, chunk);
+    crc = fcb_crc32(crc, buf, chunk);
+    data_addr += chunk;
+    remaining -= chunk;
+  }
+
+  return crc == key.crc;
+}
+
+/**
+ * @brief Resynchronise a sector scan after erased space or corrupted data.
+ *
+ * Reads the sector in FCB_SCAN_CHUNK blocks and looks for the next erased
+ * run of at least min_ff bytes, or the next FCB_ENTRY_MAGIC whose item
+ * passes its CRC check. Words that contain neither a magic byte nor an erased
+ * byte are skipped four bytes at a time. With a program unit set, items and
+ * erased runs only start on unit boundaries and the scan steps unit by unit.
+ *
+ * @param sector_num The index of the sector to scan.
+ * @param offset Sector-relative offset to start from.
+ * @param min_ff Length of the erased run that ends the scan.
+ * @param offset_out Pointer to store the sector-relative offset found.
+ * @return int 1 if an intact item was found, 0 if an erased run was found,
+ * -1 if the end of the sector was reached.
+ */
+static int fcb_resync(const Fcb *fcb, uint32_t sector_num, uint32_t offset,
+                      uint32_t min_ff, uint32_t *offset_out)
+{
+  uint32_t sector_addr = sector_num * fcb->sector_size;
+  uint8_t buf[FCB_SCAN_CHUNK];
+  uint32_t unit = (fcb->align > 1) ? fcb->align : 1;
+  uint32_t ff_run = 0;
+
+  offset = fcb_align_up(fcb, offset);
+  uint32_t start = offset;
+
+  while (offset < fcb->sector_size)
+  {
+    /* A mapped sector is scanned in place, in one go */
+    uint32_t chunk = fcb->sector_size - offset;
+    const uint8_t *p = fcb_flash_map(fcb, sector_addr + offset, chunk);
+    if (p == NULL)
+    {
+      chunk = (chunk < sizeof(buf)) ? chunk : sizeof(buf);
+      fcb_flash_read(fcb, sector_addr + offset, buf, chunk);
+      p = buf;
+    }
+
+    uint32_t i = 0;
+    while (i < chunk)
+    {
+      if (unit > 1)
+      {
+        /* Only whole erased units extend the run */
+        uint32_t ff = 0;
+        while (ff < unit && p[i + ff] == 0xFF)
+        {
+          ff++;
+        }
+
+        ff_run = (ff == unit) ? ff_run + unit : 0;
+        if (ff_run >= min_ff)
+        {
+          *offset_out = offset + i + unit - ff_run;
+          FCB_METRIC_ADD(recovery_skipped, *offset_out - start);
+          return 0;
+        }
+
+        if (p[i] == (FCB_ENTRY_MAGIC & 0xFF) &&
+            fcb_item_is_intact(fcb, sector_addr + offset + i))
+        {
+          *offset_out = offset + i;
+          FCB_METRIC_ADD(recovery_skipped, *offset_out - start);
+          return 1;
+        }
+
+        i += unit;
+        continue;
+      }
+
+      if (((offset + i) & 3) == 0 && i + 4 <= chunk)
+      {
+        uint32_t word;
+        memcpy(&word, &p[i], sizeof(word));
+
+        /* Nothing of interest in this word, skip it whole */
+        if (!FCB_HAS_BYTE(word, 0x5A) && !FCB_HAS_BYTE(word, 0xFF))
+        {
+          ff_run = 0;
+          i += 4;
+          continue;
+        }
+      }
+
+      if (p[i] == 0xFF)
+      {
+        ff_run++;
+        if (ff_run >= min_ff)
+        {
+          *offset_out = offset + i + 1 - ff_run;
+          FCB_METRIC_ADD(recovery_skipped, *offset_out - start);
+          return 0;
+        }
+      } else
+      {
+        ff_run = 0;
+
+        /* Low byte of FCB_ENTRY_MAGIC (little endian), validate by CRC */
+        if (p[i] == (FCB_ENTRY_MAGIC & 0xFF) &&
+            fcb_item_is_intact(fcb, sector_addr + offset + i))
+        {
+          *offset_out = offset + i;
+          FCB_METRIC_ADD(recovery_skipped, *offset_out - start);
+          return 1;
+        }
+      }
+
+      i++;
+    }
+
+    offset += chunk;
+  }
+
+  FCB_METRIC_ADD(recovery_skipped, fcb->sector_size - start);
+  return -1;
+}
+
+/**
+ * @brief Find the first available write position (head) in a sector.
+ *
+ * Walks the items from the sector header and returns the first FF space of
+ * at least 2*sizeof(ItemKey), or the FF space up to the sector end if it is
+ * shorter. Corrupted data is skipped by fcb_resync().
+ *
+ * @param sector_num The index of the sector to scan.
+ * @param torn_out Receives the start of the programmed bytes that directly
+ * precede the FF space without forming an item (a write cut short by power
+ * loss); equal to the returned offset when there are none.
+ * @return uint32_t The next sector-relative write offset, or 0xFFFFFFFF if
+ * full.
+ */
+static uint32_t fcb_find_sector_head_offset(const Fcb *fcb,
+                                            uint32_t sector_num,
+                                            uint32_t *torn_out)
+{
+  uint32_t sector_addr = sector_num * fcb->sector_size;
+  uint32_t offset = fcb_data_start(fcb);
+  uint32_t threshold = 2 * sizeof(struct ItemKey);
+
+  *torn_out = 0xFFFFFFFF;
+
+  while (offset < fcb->sector_size)
+  {
+    struct ItemKey key;
+    if (offset + sizeof(struct ItemKey) <= fcb->sector_size &&
+        fcb_read_item_at(fcb, sector_addr + offset, &key) == 0)
+    {
+      /* Valid item, skip it */
+      offset += fcb_item_size(fcb, key.len);
+      continue;
+    }
+
+    if (offset + threshold > fcb->sector_size)
+    {
+      /*
+       * Too short for the erased run the scan looks for, but a small item
+       * still fits (see fcb_prepare_write()): the head if nothing is
+       * programmed up to the end of the sector.
+       */
+      uint8_t tail[2 * sizeof(struct ItemKey)];
+      uint32_t len = fcb->sector_size - offset;
+      if (fcb_flash_read(fcb, sector_addr + offset, tail, len) != 0)
+      {
+        break;
+      }
+
+      uint32_t i = 0;
+      while (i < len && tail[i] == 0xFF)
+      {
+        i++;
+      }
+
+      if (i < len)
+      {
+        break;
+      }
+
+      *torn_out = offset;
+      return offset;
+    }
+
+    /* Erased space or corrupted data, scan ahead in chunks */
+    uint32_t found;
+    int rc = fcb_resync(fcb, sector_num, offset, threshold, &found);
+    if (rc == 0)
+    {
+      *torn_out = offset;
+      return found;
+    }
+
+    if (rc < 0)
+    {
+      break;
+    }
+
+    offset = found;
+  }
+
+  return 0xFFFFFFFF;
+}
+
+/**
+ * @brief Make the remains of a torn write unreadable as an item.
+ *
+ * A key cut short by power loss keeps its magic. Appending right behind it
+ * would complete its status word with the new key's bytes and let the torn
+ * length swallow the new record, while leaving a gap would read as the end
+ * of the sector once it is no longer the head. Clearing the remains to zero
+ * gives neither a magic nor erased space for the scans to stop at.
+ *
+ * @param sector_num The index of the sector.
+ * @param offset Sector-relative start of the torn bytes.
+ * @param end Sector-relative end of the region to clear.
+ */
+static void fcb_clear_torn(Fcb *fcb, uint32_t sector_num, uint32_t offset,
+                           uint32_t end)
+{
+  static const uint8_t zeros[FCB_ALIGN_MAX] = {0};
+  uint32_t addr = sector_num * fcb->sector_size + offset;
+  uint32_t len = end - offset;
+
+  while (len > 0)
+  {
+    uint32_t chunk = (len < sizeof(zeros)) ? len : sizeof(zeros);
+    if (fcb_flash_program(fcb, addr, zeros, chunk) != 0)
+    {
+      return;
+    }
+
+    addr += chunk;
+    len -= chunk;
+  }
+}
+
+/**
+ * @brief Find the first valid, not yet popped ItemKey in a sector.
+ *
+ * @param sector_num The index of the sector to scan.
+ * @return uint32_t The sector-relative offset of the first valid item, or
+ * 0xFFFFFFFF if none.
+ */
+static uint32_t fcb_find_sector_tail_offset(const Fcb *fcb,
+                                            uint32_t sector_num)
+{
+  uint32_t sector_addr = sector_num * fcb->sector_size;
+  uint32_t offset = fcb_data_start(fcb);
+  struct ItemKey key;
+
+  while (offset + sizeof(struct ItemKey) <= fcb->sector_size)
+  {
+    if (fcb_read_item_at(fcb, sector_addr + offset, &key) == 0)
+    {
+      if (key.status != FCB_STATUS_POPPED)
+      {
+        return offset;
+      }
+
+      /* Already consumed, skip over it */
+      offset += fcb_item_size(fcb, key.len);
+      continue;
+    }
+
+    /* Stop at erased space, otherwise skip the corrupted data */
+    uint32_t found;
+    if (fcb_resync(fcb, sector_num, offset, sizeof(uint32_t), &found) != 1)
+    {
+      break;
+    }
+
+    offset = found;
+  }
+
+  return 0xFFFFFFFF;
+}
+
+/**
+ * @brief Recover the global tail by finding the first valid item across
+ * sectors.
+ *
+ * Fully consumed sectors always form a prefix of the ring starting at the
+ * oldest sector, so they are skipped with a binary search before the item
+ * scan starts.
+ *
+ * @param fcb Pointer to FCB structure.
+ * @param head_addr The current absolute head address.
+ * @param tail_sector The index of the oldest sector found at mount.
+ * @return uint32_t The absolute address of the tail, or head_addr if no valid
+ * items found.
+ */
+static uint32_t fcb_recover_global_tail(Fcb *fcb, uint32_t head_addr,
+                                        int tail_sector)
+{
+  uint32_t head_sector = fcb_addr_sector(fcb, head_addr);
+
+  if (tail_sector == -1)
+  {
+    return head_addr;
+  }
+
+  uint32_t sector_count = fcb->last_sector - fcb->first_sector + 1;
+  uint32_t tail_rel = (uint32_t)tail_sector - fcb->first_sector;
+  uint32_t span =
+      (head_sector - fcb->first_sector + sector_count - tail_rel) %
+          sector_count + 1;
+  SectorHeader header;
+
+  /*
+   * Find the first sector, from the tail on, that is not consumed. Skipped
+   * sectors can sit between live ones, so they get the plain scan.
+   */
+  uint32_t lo = 0;
+  uint32_t hi = (fcb->wear_skip != 0) ? 0 : span - 1;
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint32_t sector_num = fcb->first_sector + (tail_rel + mid) % sector_count;
+
+    if (fcb_get_sector_status(fcb, sector_num, &header) == STATE_CONSUMED)
+    {
+      lo = mid + 1;
+    } else
+    {
+      hi = mid;
+    }
+  }
+
+  /* Scan sectors from there towards head_sector */
+  uint32_t i = fcb->first_sector + (tail_rel + lo) % sector_count;
+
+  for (uint32_t count = lo; count < span; count++)
+  {
+    /* Consumed sectors hold no live items, only allocated ones are scanned */
+    uint32_t state = fcb_get_sector_status(fcb, i, &header);
+    if (state == STATE_ALLOCATED || state == STATE_FULL)
+    {
+      uint32_t offset = fcb_find_sector_tail_offset(fcb, i);
+      if (offset != 0xFFFFFFFF)
+      {
+        return i * fcb->sector_size + offset;
+      }
+    }
+
+    i++;
+    if (i > fcb->last_sector)
+    {
+      i = fcb->first_sector;
+    }
+  }
+
+  return head_addr;
+}
+
+/*============================================================================
+ * Record Numbering
+ *
+ * Every appended item gets the next record number. Sector headers store the
+ * number of their first item, so the number of any item follows from its
+ * position among the intact items of its sector.
+ *============================================================================*/
+
+/**
+ * @brief Find the next intact item of a sector at or after an offset.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector to scan.
+ * @param end Sector-relative offset where the data ends.
+ * @param offset_io In: offset to start from. Out: offset of the item found.
+ * @param key_out Pointer to store the ItemKey of the item found.
+ * @return int 0 if an item was found, -2 otherwise.
+ */
+static int fcb_record_at(const Fcb *fcb, uint32_t sector_num, uint32_t end,
+                         uint32_t *offset_io, struct ItemKey *key_out)
+{
+  uint32_t min_ff = (end < fcb->sector_size) ? 2 * sizeof(struct ItemKey)
+                                             : sizeof(uint32_t);
+
+  while (*offset_io < end)
+  {
+    uint32_t offset = *offset_io;
+
+    if (offset + sizeof(struct ItemKey) <= fcb->sector_size &&
+        fcb_read_item_at(fcb, sector_num * fcb->sector_size + offset,
+                         key_out) == 0 &&
+        offset + sizeof(struct ItemKey) + key_out->len <= fcb->sector_size)
+    {
+      return 0;
+    }
+
+    uint32_t found;
+    if (fcb_resync(fcb, sector_num, offset, min_ff, &found) != 1)
+    {
+      break;
+    }
+
+    *offset_io = found;
+  }
+
+  return -2;
+}
+
+/**
+ * @brief Count the items of a sector that start before a given offset.
+ *
+ * Popped items are counted as well, they keep their record numbers.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector to scan.
+ * @param end Sector-relative offset where the data ends.
+ * @param stop Sector-relative offset to count up to.
+ * @return uint32_t Number of items found.
+ */
+static uint32_t fcb_count_records(const Fcb *fcb, uint32_t sector_num,
+                                  uint32_t end, uint32_t stop)
+{
+  struct ItemKey key;
+  uint32_t offset = fcb_data_start(fcb);
+  uint32_t count = 0;
+
+  while (fcb_record_at(fcb, sector_num, end, &offset, &key) == 0 &&
+         offset < stop)
+  {
+    count++;
+    offset += fcb_item_size(fcb, key.len);
+  }
+
+  return count;
+}
+
+/**
+ * @brief Record number of the first item of a sector.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @return uint32_t The first record number, from the RAM index if present.
+ */
+static uint32_t fcb_sector_first_record(const Fcb *fcb, uint32_t sector_num)
+{
+  if (fcb->record_index != NULL)
+  {
+    return fcb->record_index[sector_num - fcb->first_sector];
+  }
+
+  SectorHeader header;
+  fcb_read_sector_header(fcb, sector_num, &header);
+
+  return header.first_record;
+}
+
+/**
+ * @brief Record number of an intact item.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute flash address of the ItemKey.
+ * @return uint32_t The record number.
+ */
+static uint32_t fcb_record_of(const Fcb *fcb, uint32_t addr)
+{
+  uint32_t sector = fcb_addr_sector(fcb, addr);
+  uint32_t end = (sector == fcb_addr_sector(fcb, fcb->write_addr))
+                     ? fcb_addr_offset(fcb, fcb->write_addr)
+                     : fcb->sector_size;
+
+  return fcb_sector_first_record(fcb, sector) +
+         fcb_count_records(fcb, sector, end, fcb_addr_offset(fcb, addr));
+}
+
+/**
+ * @brief Load the first record number of every sector into the RAM index.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ */
+static void fcb_build_record_index(Fcb *fcb)
+{
+  if (fcb->record_index == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  {
+    SectorHeader header;
+    uint32_t state = fcb_get_sector_status(fcb, i, &header);
+
+    fcb->record_index[i - fcb->first_sector] =
+        (state != STATE_INVALID) ? header.first_record : 0;
+  }
+}
+
+/*============================================================================
+ * Sector Summaries
+ *
+ * When the writer leaves a sector it seals it: the item count, the end of
+ * the data and an aggregate CRC go into the space reserved after the
+ * header, then the header moves to STATE_FULL. Mount and record lookups
+ * take these from the summary instead of walking the items.
+ *============================================================================*/
+
+/**
+ * @brief Read and validate the summary of a sector.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @param summary Pointer to the SectorSummary structure to be populated.
+ * @return int 0 if the sector is sealed, -2 if it holds no intact summary.
+ */
+static int fcb_read_summary(const Fcb *fcb, uint32_t sector_num,
+                            SectorSummary *summary)
+{
+  fcb_flash_read(fcb, sector_num * fcb->sector_size + fcb_summary_offset(fcb),
+                 summary, sizeof(SectorSummary));
+
+  if (summary->magic != SUMMARY_MAGIC ||
+      fcb_crc32(0, summary, offsetof(SectorSummary, summary_crc)) !=
+          summary->summary_crc)
+  {
+    return -2;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Program the summary of a sector the writer is leaving.
+ *
+ * Does nothing if the sector is sealed already, which happens when mount
+ * finds the head sector sealed by a run cut short before the next sector
+ * was reserved.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
+ * @param end Sector-relative offset where the data ends.
+ */
+static void fcb_seal_sector(Fcb *fcb, uint32_t sector_num, uint32_t end)
+{
+  SectorSummary summary;
+  if (fcb_read_summary(fcb, sector_num, &summary) == 0)
+  {
+    return;
+  }
+
+  summary.magic = SUMMARY_MAGIC;
+  summary.first_record = fcb_sector_first_record(fcb, sector_num);
+  summary.record_count = 0;
+  summary.used = fcb_data_start(fcb);
+  summary.data_crc = 0;
+
+  /* Count the intact items, as a mount of this sector would */
+  struct ItemKey key;
+  uint32_t offset = fcb_data_start(fcb);
+  while (fcb_record_at(fcb, sector_num, end, &offset, &key) == 0)
+  {
+    summary.record_count++;
+    summary.data_crc = fcb_crc32(summary.data_crc, &key.crc, sizeof(key.crc));
+    offset += fcb_item_size(fcb, key.len);
+    summary.used = offset;
+  }
+
+  summary.summary_crc =
+      fcb_crc32(0, &summary, offsetof(SectorSummary, summary_crc));
+
+  if (fcb_flash_write(fcb,
+                      sector_num * fcb->sector_size + fcb_summary_offset(fcb),
+                      &summary, sizeof(SectorSummary)) == 0)
+  {
+    fcb_set_sector_state(fcb, sector_num, STATE_FULL);
+  }
+}
+
+/*============================================================================
+ * Mount Checkpoints
+ *
+ * fcb_checkpoint() records the positions in a sector of its own after the
+ * ring. A checkpoint is only trusted while the write sector it names is
+ * still the newest one and is erased at the recorded write address, that
+ * is, while nothing has been appended since; otherwise mount scans.
+ *============================================================================*/
+
+/**
+ * @brief Distance between two checkpoint slots.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return uint32_t A MountCheckpoint rounded up to the program unit.
+ */
+static uint32_t fcb_ckpt_size(const Fcb *fcb)
+{
+  return fcb_align_up(fcb, sizeof(MountCheckpoint));
+}
+
+/**
+ * @brief Check whether a checkpoint slot is still erased.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute address of the slot.
+ * @return int 1 if every byte of the slot is 0xFF, 0 otherwise.
+ */
+static int fcb_ckpt_slot_is_free(const Fcb *fcb, uint32_t addr)
+{
+  uint8_t buf[FCB_ALIGN_MAX];
+  uint32_t size = fcb_ckpt_size(fcb);
+
+  if (fcb_flash_read(fcb, addr, buf, size) != 0)
+  {
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < size; i++)
+  {
+    if (buf[i] != 0xFF)
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Find the newest checkpoint of a checkpoint sector.
+ *
+ * Binary search for the first erased slot; the slot before it holds the
+ * newest checkpoint.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the checkpoint sector.
+ * @param ckpt Pointer to store the checkpoint.
+ * @param free_out Pointer to store the index of the first erased slot (the
+ * slot count if the sector is full).
+ * @return int 0 if the newest checkpoint is intact, -2 otherwise.
+ */
+static int fcb_ckpt_latest(const Fcb *fcb, uint32_t sector_num,
+                           MountCheckpoint *ckpt, uint32_t *free_out)
+{
+  uint32_t size = fcb_ckpt_size(fcb);
+  uint32_t base = sector_num * fcb->sector_size;
+  uint32_t lo = 0;
+  uint32_t hi = fcb->sector_size / size;
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (fcb_ckpt_slot_is_free(fcb, base + mid * size))
+    {
+      hi = mid;
+    } else
+    {
+      lo = mid + 1;
+    }
+  }
+
+  *free_out = lo;
+
+  if (lo == 0 ||
+      fcb_flash_read(fcb, base + (lo - 1) * size, ckpt,
+                     sizeof(MountCheckpoint)) != 0 ||
+      ckpt->magic != CHECKPOINT_MAGIC ||
+      fcb_crc32(0, ckpt, offsetof(MountCheckpoint, crc)) != ckpt->crc)
+  {
+    return -2;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Load the newest checkpoint and find the slot for the next one.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param ckpt Pointer to store the checkpoint.
+ * @return int 0 if an intact checkpoint was found, -2 otherwise.
+ */
+static int fcb_ckpt_load(Fcb *fcb, MountCheckpoint *ckpt)
+{
+  uint32_t size = fcb_ckpt_size(fcb);
+  uint32_t slots = fcb->sector_size / size;
+  uint32_t active = 0;
+  uint32_t active_free = 0;
+  int found = 0;
+
+  memset(ckpt, 0, sizeof(MountCheckpoint));
+  fcb->ckpt_counter = 0;
+
+  for (uint32_t i = 0; i < fcb->ckpt_sectors; i++)
+  {
+    MountCheckpoint latest;
+    uint32_t free_slot;
+    int rc = fcb_ckpt_latest(fcb, fcb->last_sector + 1 + i, &latest,
+                             &free_slot);
+
+    int newer = rc == 0 &&
+                (!found || SEQ_IS_NEWER(latest.counter, fcb->ckpt_counter));
+
+    if (i == 0 || newer)
+    {
+      active = i;
+      active_free = free_slot;
+    }
+
+    if (newer)
+    {
+      *ckpt = latest;
+      fcb->ckpt_counter = latest.counter;
+      found = 1;
+    }
+  }
+
+  /* Continue in the active sector, or start over in the next one */
+  if (active_free == slots)
+  {
+    active = (active + 1) % fcb->ckpt_sectors;
+    active_free = 0;
+  }
+
+  fcb->ckpt_addr = (fcb->last_sector + 1 + active) * fcb->sector_size +
+                   active_free * size;
+
+  return found ? 0 : -2;
+}
+
+/**
+ * @brief Check that a recorded position can be an item address.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr The absolute address to check.
+ * @return int 1 if addr lies in the data area of a ring sector, 0 otherwise.
+ */
+static int fcb_ckpt_pos_ok(const Fcb *fcb, uint32_t addr)
+{
+  return fcb_sector_in_range(fcb, fcb_addr_sector(fcb, addr)) &&
+         fcb_addr_offset(fcb, addr) >= fcb_data_start(fcb);
+}
+
+/**
+ * @brief Take the positions from the newest checkpoint if it still holds.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 if the positions were restored, -2 if mount has to scan.
+ */
+static int fcb_mount_checkpoint(Fcb *fcb)
+{
+  MountCheckpoint ckpt;
+  SectorHeader header;
+
+  if (fcb_ckpt_load(fcb, &ckpt) != 0 ||
+      !fcb_ckpt_pos_ok(fcb, ckpt.write_addr) ||
+      !fcb_ckpt_pos_ok(fcb, ckpt.read_addr) ||
+      !fcb_ckpt_pos_ok(fcb, ckpt.delete_addr))
+  {
+    return -2;
+  }
+
+  /* The write sector has not been left (it would be sealed or superseded) */
+  uint32_t head = fcb_addr_sector(fcb, ckpt.write_addr);
+  if (fcb_get_sector_status(fcb, head, &header) != STATE_ALLOCATED ||
+      header.sequence_id != ckpt.sector_id)
+  {
+    return -2;
+  }
+
+  uint32_t next = fcb_next_sector(fcb, head);
+  uint32_t state = fcb_get_sector_status(fcb, next, &header);
+  while (state == STATE_SKIPPED && next != head)
+  {
+    next = fcb_next_sector(fcb, next);
+    state = fcb_get_sector_status(fcb, next, &header);
+  }
+
+  if (next != head && state != STATE_INVALID &&
+      SEQ_IS_NEWER(header.sequence_id, ckpt.sector_id))
+  {
+    return -2;
+  }
+
+  /* Nothing appended since, not even a torn key */
+  uint8_t buf[2 * sizeof(struct ItemKey)];
+  if (fcb_addr_offset(fcb, ckpt.write_addr) + sizeof(buf) > fcb->sector_size ||
+      fcb_flash_read(fcb, ckpt.write_addr, buf, sizeof(buf)) != 0)
+  {
+    return -2;
+  }
+
+  for (uint32_t i = 0; i < sizeof(buf); i++)
+  {
+    if (buf[i] != 0xFF)
+    {
+      return -2;
+    }
+  }
+
+  fcb->write_addr = ckpt.write_addr;
+  fcb->read_addr = ckpt.read_addr;
+  fcb->delete_addr = ckpt.delete_addr;
+
+  if (fcb_ring_distance(fcb, fcb->delete_addr, fcb->read_addr) >
+      fcb_ring_distance(fcb, fcb->delete_addr, fcb->write_addr))
+  {
+    return -2;
+  }
+
+  /* Later pops only mark items, a consumed or erased sector is not taken */
+  uint32_t positions[2] = {ckpt.delete_addr, ckpt.read_addr};
+  for (int i = 0; i < 2; i++)
+  {
+    struct ItemKey key;
+    if (positions[i] == ckpt.write_addr)
+    {
+      continue;
+    }
+
+    state = fcb_get_sector_status(fcb, fcb_addr_sector(fcb, positions[i]),
+                                  &header);
+    if ((state != STATE_ALLOCATED && state != STATE_FULL) ||
+        fcb_read_item_at(fcb, positions[i], &key) != 0)
+    {
+      return -2;
+    }
+  }
+
+  fcb->current_sector_id = ckpt.sector_id;
+  fcb->next_record = ckpt.next_record;
+  fcb_build_record_index(fcb);
+
+  return 0;
+}
+
+/**
+ * @brief Record the buffer positions so the next mount can skip its scans.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, -1 on invalid arguments or if checkpoints are
+ * off, -3 on flash error.
+ */
+int fcb_checkpoint(Fcb *fcb)
+{
+  if (fcb == NULL || fcb->dev == NULL || fcb->ckpt_sectors == 0)
+  {
+    return -1;
+  }
+
+  /* The recorded write address must be on flash */
+  if (fcb_wb_commit(fcb, fcb->wb_len) != 0)
+  {
+    return -3;
+  }
+
+  /* Starting a sector over: erase it unless it is blank already */
+  uint32_t addr = fcb->ckpt_addr;
+  if (fcb_addr_offset(fcb, addr) == 0 && !fcb_ckpt_slot_is_free(fcb, addr))
+  {
+    FCB_METRIC_BEGIN(erase);
+    int rc = fcb->dev->ops->erase(fcb->dev->ctx, addr, fcb->sector_size);
+    FCB_METRIC_END(FCB_METRIC_ERASE, erase);
+    if (rc != 0)
+    {
+      return -3;
+    }
+
+    fcb->stat_erases++;
+  }
+
+  MountCheckpoint ckpt;
+  ckpt.magic = CHECKPOINT_MAGIC;
+  ckpt.counter = fcb->ckpt_counter + 1;
+  ckpt.sector_id = fcb->current_sector_id;
+  ckpt.write_addr = fcb->write_addr;
+  ckpt.read_addr = fcb->read_addr;
+  ckpt.delete_addr = fcb->delete_addr;
+  ckpt.next_record = fcb->next_record;
+  ckpt.crc = fcb_crc32(0, &ckpt, offsetof(MountCheckpoint, crc));
+
+  /* Pad to whole program units */
+  uint8_t slot[FCB_ALIGN_MAX];
+  uint32_t size = fcb_ckpt_size(fcb);
+  memset(slot, 0xFF, size);
+  memcpy(slot, &ckpt, sizeof(MountCheckpoint));
+
+  int rc = fcb_flash_write(fcb, addr, slot, size);
+
+  /* The slot is used up even if programming failed */
+  fcb->ckpt_counter = ckpt.counter;
+  addr += size;
+  if (fcb_addr_offset(fcb, addr) + size > fcb->sector_size ||
+      fcb_addr_offset(fcb, addr) == 0)
+  {
+    uint32_t index = (fcb_addr_sector(fcb, fcb->ckpt_addr)) -
+                     (fcb->last_sector + 1);
+    addr = (fcb->last_sector + 1 + (index + 1) % fcb->ckpt_sectors) *
+           fcb->sector_size;
+  }
+  fcb->ckpt_addr = addr;
+
+  return (rc == 0) ? 0 : -3;
+}
+
+/**
+ * @brief Initialize the FCB by scanning the flash sectors.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, non-zero error code otherwise.
+ */
+int fcb_mount(Fcb *fcb)
+{
+  if (fcb == NULL || fcb->dev == NULL || fcb_check_geometry(fcb) != 0)
+  {
+    return -1;
+  }
+
+  if (fcb->erase_status == FCB_ERASE_BUSY)
+  {
+    return -4;
+  }
+
+  fcb->sector_shift = fcb_sector_shift(fcb->sector_size);
+
+  if (fcb->durability == FCB_DURABLE_TIME && fcb->clock == NULL)
+  {
+    return -1;
+  }
+
+  if (fcb->kv_index != NULL &&
+      (fcb->kv_slots == 0 || (fcb->kv_slots & (fcb->kv_slots - 1)) != 0))
+  {
+    return -1;
+  }
+
+  /* Nothing is known about the sectors ahead until fcb_idle() runs */
+  fcb->erase_status = FCB_ERASE_IDLE;
+  fcb->erased_ahead = 0;
+  fcb->wb_len = 0;
+  fcb_cache_reset(fcb);
+  fcb->overwritten = 0;
+  fcb->stat_erases = 0;
+  fcb->stat_appended = 0;
+  fcb->stat_programmed = 0;
+
+  FCB_METRIC_READS_BEGIN(mount);
+
+  if (fcb->ckpt_sectors != 0 && fcb_mount_checkpoint(fcb) == 0)
+  {
+    /* Positions restored from the checkpoint, no sector or item scans */
+    fcb_kv_build(fcb);
+
+    FCB_METRIC_READS_END(mount_reads, mount);
+    return 0;
+  }
+
+  uint32_t highest_seq;
+  int head_sector;
+  int tail_sector;
+
+  /*
+   * Skipped sectors break the run of consecutive sequence IDs the binary
+   * search relies on, so wear skipping always takes the full scan.
+   */
+  FCB_METRIC_BEGIN(header_scan);
+  if (fcb->wear_skip != 0 ||
+      fcb_search_head_tail(fcb, &head_sector, &tail_sector, &highest_seq) != 0)
+  {
+    /* Corrupted or inconsistent headers, fall back to a full scan */
+    fcb_find_head_tail(fcb, &head_sector, &tail_sector, &highest_seq);
+  }
+  FCB_METRIC_END(FCB_METRIC_HEADER_SCAN, header_scan);
+
+  if (head_sector == -1)
+  {
+    /* No active sectors found, start with a freshly reserved first sector */
+    fcb->current_sector_id = 0;
+    fcb->next_record = 0;
+    fcb_flash_erase(fcb, fcb->first_sector);
+    fcb_append_sector(fcb, fcb->first_sector);
+    fcb->write_addr =
+        fcb->first_sector * fcb->sector_size + fcb_data_start(fcb);
+    fcb->read_addr = fcb->write_addr;
+    fcb->delete_addr = fcb->write_addr;
+    fcb_kv_build(fcb);
+
+    FCB_METRIC_READS_END(mount_reads, mount);
+    return 0;
+  }
+
+  fcb->current_sector_id = highest_seq;
+  fcb_build_record_index(fcb);
+
+  /* Recover head position in the newer sector */
+  FCB_METRIC_BEGIN(head_scan);
+  uint32_t head_offset = 0xFFFFFFFF;
+  SectorSummary summary;
+
+  if (fcb_read_summary(fcb, (uint32_t)head_sector, &summary) == 0)
+  {
+    /* Sealed before the next sector was reserved, nothing to scan */
+    fcb->next_record = summary.first_record + summary.record_count;
+  } else
+  {
+    uint32_t torn;
+    head_offset =
+        fcb_find_sector_head_offset(fcb, (uint32_t)head_sector, &torn);
+
+    if (head_offset != 0xFFFFFFFF && torn < head_offset)
+    {
+      /* Clear at least a whole key so its status word can never complete */
+      uint32_t end = fcb_align_up(fcb, torn + sizeof(struct ItemKey));
+      end = (end > head_offset) ? end : head_offset;
+      end = (end < fcb->sector_size) ? end : fcb->sector_size;
+
+      fcb_clear_torn(fcb, (uint32_t)head_sector, torn, end);
+      head_offset = (end + 2 * sizeof(struct ItemKey) <= fcb->sector_size)
+                        ? end
+                        : 0xFFFFFFFF;
+    }
+
+    /* Continue record numbering after the last item of the head sector */
+    uint32_t head_end =
+        (head_offset == 0xFFFFFFFF) ? fcb->sector_size : head_offset;
+    fcb->next_record =
+        fcb_sector_first_record(fcb, (uint32_t)head_sector) +
+        fcb_count_records(fcb, (uint32_t)head_sector, head_end, head_end);
+  }
+  FCB_METRIC_END(FCB_METRIC_ITEM_SCAN, head_scan);
+
+  if (head_offset == 0xFFFFFFFF)
+  {
+    /*
+     * No FF space left in the newer sector. Park the write address on its
+     * last byte so the next append rolls over; erasing the next sector here
+     * would destroy it if it is the tail of a full buffer.
+     */
+    fcb->write_addr =
+        (uint32_t)head_sector * fcb->sector_size + fcb->sector_size - 1;
+  } else
+  {
+    fcb->write_addr = (uint32_t)head_sector * fcb->sector_size + head_offset;
+  }
+
+  /* Recover tail position (first valid ItemKey across sectors) */
+  FCB_METRIC_BEGIN(tail_scan);
+  fcb->read_addr = fcb_recover_global_tail(fcb, fcb->write_addr, tail_sector);
+  fcb->delete_addr = fcb->read_addr;
+  FCB_METRIC_END(FCB_METRIC_ITEM_SCAN, tail_scan);
+
+  /* Latest record of every ID, later records replace earlier ones */
+  FCB_METRIC_BEGIN(kv_scan);
+  fcb_kv_build(fcb);
+  FCB_METRIC_END(FCB_METRIC_ITEM_SCAN, kv_scan);
+
+  FCB_METRIC_READS_END(mount_reads, mount);
+  return 0;
+}
+
+/**
+ * @brief Erase all sectors associated with the FCB and reset its state.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, non-zero error code otherwise.
+ */
+int fcb_erase(Fcb *fcb)
+{
+  if (fcb == NULL || fcb->dev == NULL || fcb_check_geometry(fcb) != 0)
+  {
+    return -1;
+  }
+
+  if (fcb->erase_status == FCB_ERASE_BUSY)
+  {
+    return -4;
+  }
+
+  fcb->sector_shift = fcb_sector_shift(fcb->sector_size);
+
+  /* Reset internally tracked sector state, buffered data is discarded */
+  fcb->current_sector_id = 0;
+  fcb->next_record = 0;
+  fcb->wb_len = 0;
+  fcb_cache_reset(fcb);
+  fcb->overwritten = 0;
+
+  /* Erase all sectors in the FCB range */
+  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  {
+    fcb_flash_erase(fcb, i);
+  }
+
+  /* Checkpoints of the old contents must not survive */
+  for (uint32_t i = 0; i < fcb->ckpt_sectors; i++)
+  {
+    fcb->dev->ops->erase(fcb->dev->ctx,
+                         (fcb->last_sector + 1 + i) * fcb->sector_size,
+                         fcb->sector_size);
+  }
+  fcb->ckpt_addr = (fcb->last_sector + 1) * fcb->sector_size;
+  fcb->ckpt_counter = 0;
+
+  /* Reserve the first sector so appended items always follow a header */
+  fcb_append_sector(fcb, fcb->first_sector);
+
+  /* Re-initialize tracking addresses to the start of the first sector */
+  fcb->write_addr =
+      fcb->first_sector * fcb->sector_size + fcb_data_start(fcb);
+  fcb->read_addr = fcb->write_addr;
+  fcb->delete_addr = fcb->write_addr;
+  fcb_kv_build(fcb);
+
+  /* Every sector after the first one is erased now */
+  fcb->erase_status = FCB_ERASE_IDLE;
+  fcb->erased_ahead = fcb->last_sector - fcb->first_sector;
+
+  return 0;
+}
+
+/**
+ * @brief Completion callback of a background sector erase.
+ *
+ * May run in interrupt context, so it only publishes the result; the
+ * counters are updated by fcb_collect_erase() from the FCB's own context.
+ *
+ * @param rc 0 on success, negative backend error code otherwise.
+ * @param arg Pointer to the FCB logistics structure.
+ */
+static void fcb_erase_done(int rc, void *arg)
+{
+  Fcb *fcb = (Fcb *)arg;
+
+  fcb->erase_status = (rc == 0) ? FCB_ERASE_DONE : FCB_ERASE_FAILED;
+}
+
+/**
+ * @brief Account for a completed background erase.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ */
+static void fcb_collect_erase(Fcb *fcb)
+{
+  int status = fcb->erase_status;
+
+  if (status == FCB_ERASE_DONE)
+  {
+    fcb->stat_erases++;
+    fcb_stamp_erase_count(fcb, fcb->erase_target, fcb->erase_target_count);
+    fcb->erased_ahead++;
+  }
+
+  if (status == FCB_ERASE_DONE || status == FCB_ERASE_FAILED)
+  {
+    fcb->erase_status = FCB_ERASE_IDLE;
+  }
+}
+
+/**
+ * @brief Idle hook: prepare sectors ahead of the write position.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 1 if an erase was started or is still in progress, 0 if there
+ * is nothing to do, -1 on invalid arguments, -3 on flash error.
+ */
+int fcb_idle(Fcb *fcb)
+{
+  if (fcb == NULL || fcb->dev == NULL)
+  {
+    return -1;
+  }
+
+  if (fcb_wb_apply_policy(fcb) != 0)
+  {
+    return -3;
+  }
+
+  fcb_collect_erase(fcb);
+  if (fcb->erase_status == FCB_ERASE_BUSY)
+  {
+    return 1;
+  }
+
+  if (fcb->erased_ahead >= fcb->erase_ahead)
+  {
+    return 0;
+  }
+
+  /* Next sector after the ones already erased, following the ring */
+  uint32_t sector_count = fcb->last_sector - fcb->first_sector + 1;
+  uint32_t write_sector = fcb_addr_sector(fcb, fcb->write_addr);
+  uint32_t target = fcb->first_sector +
+                    (write_sector - fcb->first_sector + fcb->erased_ahead + 1) %
+                        sector_count;
+
+  /* Never erase the write sector or a sector still holding items */
+  if (target == write_sector ||
+      target == fcb_addr_sector(fcb, fcb->delete_addr))
+  {
+    return 0;
+  }
+
+  /* Worn sectors are left for fcb_pick_sector() to pass over on rollover */
+  uint32_t erase_count = fcb_sector_erase_count(fcb, target);
+  if (fcb->wear_skip != 0)
+  {
+    uint32_t min_wear;
+    fcb_wear_range(fcb, &min_wear, NULL, NULL);
+    if (erase_count > min_wear + fcb->wear_skip)
+    {
+      return 0;
+    }
+  }
+
+  if (fcb->dev->ops->erase_async != NULL)
+  {
+    fcb_cache_drop_sector(fcb, target);
+    fcb_kv_drop_sector(fcb, target);
+    fcb->erase_target = target;
+    fcb->erase_target_count = erase_count + 1;
+    fcb->erase_status = FCB_ERASE_BUSY;
+    int rc = fcb->dev->ops->erase_async(
+        fcb->dev->ctx, target * fcb->sector_size, fcb->sector_size,
+        fcb_erase_done, fcb);
+    if (rc == 0)
+    {
+      return 1;
+    }
+
+    fcb->erase_status = FCB_ERASE_IDLE;
+    if (rc != -2)
+    {
+      return -3;
+    }
+
+    /* Device busy with another operation, erase synchronously instead */
+  }
+
+  if (fcb_flash_erase(fcb, target) != 0)
+  {
+    return -3;
+  }
+
+  fcb->erased_ahead++;
+
+  return 1;
+}
+
+/**
+ * @brief Drop the oldest sector to make room in overwrite mode.
+ *
+ * Counts the unconsumed records left in the sector, retires it and moves the
+ * delete (and if needed the read) position to the next live item.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param tail_sector The index of the sector holding the delete position.
+ */
+static void fcb_reclaim_tail(Fcb *fcb, uint32_t tail_sector)
+{
+  struct ItemKey key;
+  uint32_t old_delete = fcb->delete_addr;
+  uint32_t addr = old_delete;
+  SectorSummary summary;
+
+  if (fcb_addr_offset(fcb, old_delete) == fcb_data_start(fcb) &&
+      fcb_read_summary(fcb, tail_sector, &summary) == 0)
+  {
+    /* Nothing popped in a sealed sector, its summary has the count */
+    fcb->overwritten += summary.record_count;
+    addr = tail_sector * fcb->sector_size + summary.used;
+  }
+
+  /* fcb_locate_item() leaves addr on the first live item after the sector */
+  while (fcb_locate_item(fcb, &addr, &key) == 0 &&
+         fcb_addr_sector(fcb, addr) == tail_sector)
+  {
+    fcb->overwritten++;
+    addr += fcb_item_size(fcb, key.len);
+  }
+
+  fcb_set_sector_state(fcb, tail_sector, STATE_CONSUMED);
+
+  if (fcb_ring_distance(fcb, old_delete, fcb->read_addr) <
+      fcb_ring_distance(fcb, old_delete, addr))
+  {
+    fcb->read_addr = addr;
+  }
+
+  fcb->delete_addr = addr;
+}
+
+/**
+ * @brief Make sure the current sector has room for an item.
+ *
+ * Moves the write address to a freshly erased and reserved sector when the
+ * item does not fit in the remainder of the current one. In keyed mode the
+ * records copied forward by fcb_kv_collect() may leave too little room in
+ * the new sector, then it moves once more.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item_size Size of the item (ItemKey and payload) in bytes.
+ * @return int 0 on success, -1 if the item can never fit in a sector, -2 if
+ * the buffer is full, -3 if the new sector could not be erased, -4 if it is
+ * still being erased in the background.
+ */
+static int fcb_prepare_write(Fcb *fcb, uint32_t item_size)
+{
+  if (item_size >= fcb->sector_size - fcb_data_start(fcb))
+  {
+    return -1;
+  }
+
+  for (int moves = 0;; moves++)
+  {
+    /*
+     * Check if current sector has room for the item. The write address must
+     * stay inside its sector, so an item may not end exactly at the boundary.
+     */
+    uint32_t current_sector_num = fcb_addr_sector(fcb, fcb->write_addr);
+    uint32_t offset_in_sector = fcb_addr_offset(fcb, fcb->write_addr);
+
+    if (offset_in_sector + item_size < fcb->sector_size)
+    {
+      return 0;
+    }
+
+    if (moves == 2)
+    {
+      /* The live keyed records fill the ring */
+      return -2;
+    }
+
+    /* Not enough space in current sector, move to the next one */
+    uint32_t next_sector = fcb_next_sector(fcb, current_sector_num);
+    uint32_t tail_sector = fcb_addr_sector(fcb, fcb->delete_addr);
+
+    /* Sectors erased ahead are known usable, otherwise mind the wear */
+    fcb_collect_erase(fcb);
+    if (fcb->wear_skip != 0 && fcb->erased_ahead == 0 &&
+        fcb->erase_status != FCB_ERASE_BUSY)
+    {
+      next_sector = fcb_pick_sector(fcb, next_sector, tail_sector);
+    }
+
+    /* Check if we are about to overwrite the oldest sector (tail) */
+    if (next_sector == tail_sector)
+    {
+      if (fcb->full_policy != FCB_FULL_OVERWRITE)
+      {
+        /* Buffer is full */
+        return -2;
+      }
+
+      fcb_reclaim_tail(fcb, tail_sector);
+    }
+
+    /* Items buffered for the old sector must reach flash before it is left */
+    if (fcb_wb_commit(fcb, fcb->wb_len) != 0)
+    {
+      return -3;
+    }
+
+    /* Use a sector erased ahead of time, otherwise erase it now */
+    if (fcb->erased_ahead > 0)
+    {
+      fcb->erased_ahead--;
+    } else if (fcb->erase_status == FCB_ERASE_BUSY)
+    {
+      /* The background erase of exactly this sector is still running */
+      return -4;
+    } else if (fcb_flash_erase(fcb, next_sector) != 0)
+    {
+      return -3;
+    }
+
+    /* Nothing can fail from here on, the old sector is left for good */
+    fcb_seal_sector(fcb, current_sector_num, offset_in_sector);
+    fcb_append_sector(fcb, next_sector);
+
+    /* Update write address to start after the new sector header */
+    fcb->write_addr = next_sector * fcb->sector_size + fcb_data_start(fcb);
+
+    /* Keep a sector free ahead of the writer by collecting the oldest one */
+    uint32_t ahead = fcb_next_sector(fcb, next_sector);
+    if (fcb->kv_index != NULL &&
+        ahead == fcb_addr_sector(fcb, fcb->delete_addr))
+    {
+      fcb_kv_collect(fcb);
+    }
+  }
+}
+
+/**
+ * @brief Compress a record into lz_buf if that makes it smaller.
+ *
+ * The stored payload is the original length (16 bits, little endian)
+ * followed by the LZ4 block.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param data In: the record. Out: the payload to store.
+ * @param len In: record length. Out: payload length.
+ * @return uint16_t FCB_KEY_FLAG_LZ if the record was compressed, else 0.
+ */
+static uint16_t fcb_lz_pack(Fcb *fcb, const void **data, uint16_t *len)
+{
+  if (fcb->lz_buf == NULL || fcb->lz_size <= 2)
+  {
+    return 0;
+  }
+
+  /* Worth it only if the payload ends up at least a byte shorter */
+  uint32_t cap = fcb->lz_size - 2;
+  if (*len < 4)
+  {
+    return 0;
+  }
+  cap = (cap < (uint32_t)*len - 3) ? cap : (uint32_t)*len - 3;
+
+  uint32_t packed =
+      fcb_lz_compress((const uint8_t *)*data, *len, fcb->lz_buf + 2, cap);
+  if (packed == 0)
+  {
+    return 0;
+  }
+
+  fcb->lz_buf[0] = (uint8_t)(*len & 0xFF);
+  fcb->lz_buf[1] = (uint8_t)(*len >> 8);
+  *data = fcb->lz_buf;
+  *len = (uint16_t)(packed + 2);
+
+  return FCB_KEY_FLAG_LZ;
+}
+
+/**
+ * @brief Write one item, whose payload is given in pieces, and advance.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param flags FCB_KEY_FLAG_* bits to clear in the item magic.
+ * @param parts Payload pieces, stored back to back.
+ * @param cnt Number of pieces.
+ * @param raw_len Record length accounted in the append statistics.
+ * @return int 0 on success, -1 if the item can never fit in a sector, -2 if
+ * the buffer is full, -3 on flash error, -4 if the next sector is still
+ * being erased in the background.
+ */
+static int fcb_write_item(Fcb *fcb, uint16_t flags, const FcbIovec *parts,
+                          size_t cnt, uint16_t raw_len)
+{
+  uint32_t len = 0;
+  for (size_t i = 0; i < cnt; i++)
+  {
+    len += parts[i].iov_len;
+  }
+
+  if (len > 0xFFFF)
+  {
+    return -1;
+  }
+
+  uint32_t item_size = fcb_item_size(fcb, len);
+
+  int rc = fcb_prepare_write(fcb, item_size);
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  /* Prepare the item key */
+  struct ItemKey key;
+  key.magic = FCB_ENTRY_MAGIC & ~flags;
+  key.len = (uint16_t)len;
+  key.crc = 0;
+  for (size_t i = 0; i < cnt; i++)
+  {
+    key.crc = fcb_crc32(key.crc, parts[i].iov_base, parts[i].iov_len);
+  }
+  key.status = FCB_STATUS_VALID;
+
+  /* Erased padding up to the next program unit */
+  uint32_t pad = item_size - sizeof(struct ItemKey) - len;
+  uint8_t fill[FCB_ALIGN_MAX];
+  memset(fill, 0xFF, pad);
+
+  uint32_t addr = fcb->write_addr + sizeof(struct ItemKey);
+  fcb_cache_insert(fcb, fcb->write_addr, &key, parts, cnt);
+
+  if (fcb_wb_enabled(fcb))
+  {
+    /* Combine with neighbouring items, the policy decides when to program */
+    rc = fcb_wb_write(fcb, fcb->write_addr, &key, sizeof(struct ItemKey));
+    for (size_t i = 0; i < cnt; i++)
+    {
+      int err = fcb_wb_write(fcb, addr, parts[i].iov_base, parts[i].iov_len);
+      rc = (rc != 0) ? rc : err;
+      addr += parts[i].iov_len;
+    }
+    int err = fcb_wb_write(fcb, addr, fill, pad);
+    fcb->write_addr += item_size;
+    fcb->next_record++;
+    fcb->stat_appended += raw_len;
+
+    rc = (rc != 0) ? rc : err;
+    err = fcb_wb_apply_policy(fcb);
+
+    return (rc == 0 && err == 0) ? 0 : -3;
+  }
+
+  if (fcb->align > 1 || cnt > 1)
+  {
+    /* Assemble the item so that only whole program units are written */
+    FcbStage stage;
+    fcb_stage_init(fcb, &stage);
+
+    fcb_stage_write(fcb, &stage, &key, sizeof(struct ItemKey));
+    for (size_t i = 0; i < cnt; i++)
+    {
+      fcb_stage_write(fcb, &stage, parts[i].iov_base, parts[i].iov_len);
+    }
+    fcb_stage_write(fcb, &stage, fill, pad);
+    fcb_stage_flush(fcb, &stage);
+    rc = stage.rc;
+  } else
+  {
+    /* Write the item key and payload to flash */
+    rc = fcb_flash_write(fcb, fcb->write_addr, &key, sizeof(struct ItemKey));
+    if (rc == 0 && cnt > 0)
+    {
+      rc = fcb_flash_write(fcb, addr, parts[0].iov_base, parts[0].iov_len);
+    }
+  }
+
+  /* Advance the write address, a failed item is skipped by the readers */
+  fcb->write_addr += item_size;
+  fcb->next_record++;
+  fcb->stat_appended += raw_len;
+
+  return (rc == 0) ? 0 : -3;
+}
+
+/**
+ * @brief Append an item to the FCB.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param data Pointer to the data to be written.
+ * @param len Length of the data in bytes.
+ * @return int 0 on success, non-zero error code otherwise.
+ */
+int fcb_append(Fcb *fcb, const void *data, uint16_t len)
+{
+  if (fcb == NULL || data == NULL || len == 0)
+  {
+    return -1;
+  }
+
+  /* A record that shrinks is stored compressed in its place */
+  uint16_t raw_len = len;
+  uint16_t flags = fcb_lz_pack(fcb, &data, &len);
+
+  FcbIovec part;
+  part.iov_base = data;
+  part.iov_len = len;
+
+  return fcb_write_item(fcb, flags, &part, 1, raw_len);
+}
+
+/**
+ * @brief Append one item gathered from several buffers.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param iov Array of segments, empty ones are allowed.
+ * @param cnt Number of entries in the array.
+ * @return int 0 on success, -1 on invalid arguments, otherwise as
+ * fcb_append().
+ */
+int fcb_appendv(Fcb *fcb, const FcbIovec *iov, size_t cnt)
+{
+  if (fcb == NULL || fcb->dev == NULL || iov == NULL)
+  {
+    return -1;
+  }
+
+  uint32_t len = 0;
+  for (size_t i = 0; i < cnt; i++)
+  {
+    if (iov[i].iov_base == NULL && iov[i].iov_len > 0)
+    {
+      return -1;
+    }
+
+    len += iov[i].iov_len;
+    if (len > 0xFFFF)
+    {
+      return -1;
+    }
+  }
+
+  if (len == 0)
+  {
+    return -1;
+  }
+
+  return fcb_write_item(fcb, 0, iov, cnt, (uint16_t)len);
+}
+
+/**
+ * @brief Locate the item at the read position, which may still be in RAM.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item Pointer to store the item location.
+ * @return int 0 on success, -2 if no unread item.
+ */
+static int fcb_locate_read(Fcb *fcb, FcbItem *item)
+{
+  struct ItemKey key;
+  int rc = fcb_locate_item(fcb, &fcb->read_addr, &key);
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  item->addr = fcb->read_addr + sizeof(struct ItemKey);
+  item->len = key.len;
+  item->crc = key.crc;
+  item->flags = fcb_item_flags(&key);
+  item->data = NULL;
+
+  return 0;
+}
+
+/**
+ * @brief Locate the item at the read position without consuming it.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item Pointer to store the item location.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no unread item.
+ */
+int fcb_peek(Fcb *fcb, FcbItem *item)
+{
+  if (fcb == NULL || item == NULL)
+  {
+    return -1;
+  }
+
+  int rc = fcb_locate_read(fcb, item);
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  /* The caller reads the payload from flash, so it has to be there */
+  if (fcb->wb_len > 0 && item->addr + item->len > fcb->wb_addr)
+  {
+    fcb_wb_commit(fcb, fcb->wb_len);
+  }
+
+  item->data = fcb_flash_map(fcb, item->addr, item->len);
+
+  return 0;
+}
+
+/**
+ * @brief Hand out the item at the read position and advance past it.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item Pointer to store the item location.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no unread item.
+ */
+int fcb_next(Fcb *fcb, FcbItem *item)
+{
+  int rc = fcb_peek(fcb, item);
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  fcb->read_addr = fcb_align_up(fcb, item->addr + item->len);
+
+  return 0;
+}
+
+/**
+ * @brief Decompress the item at the read position into a buffer.
+ *
+ * The stored payload is verified before it is decoded. Without a mapped
+ * view it is read into lz_buf first, as the decoder needs all of it.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item Location of the compressed item.
+ * @param buf Destination buffer.
+ * @param buf_len Size of the destination buffer in bytes.
+ * @param len_out Optional pointer to store the record length.
+ * @return int 0 on success, -3 if buf (or lz_buf) is too small, -4 if the
+ * payload failed its CRC check or does not decode.
+ */
+static int fcb_read_packed(Fcb *fcb, const FcbItem *item, void *buf,
+                           uint16_t buf_len, uint16_t *len_out)
+{
+  const uint8_t *src = fcb_flash_map(fcb, item->addr, item->len);
+  if (src == NULL)
+  {
+    if (fcb->lz_buf == NULL || item->len > fcb->lz_size)
+    {
+      return -3;
+    }
+
+    fcb_flash_read(fcb, item->addr, fcb->lz_buf, item->len);
+    src = fcb->lz_buf;
+  }
+
+  uint32_t next = fcb_align_up(fcb, item->addr + item->len);
+  if (item->len < 2 || fcb_crc32(0, src, item->len) != item->crc)
+  {
+    fcb->read_addr = next;
+    return -4;
+  }
+
+  uint16_t raw_len = (uint16_t)(src[0] | (src[1] << 8));
+  if (len_out != NULL)
+  {
+    *len_out = raw_len;
+  }
+
+  if (raw_len > buf_len)
+  {
+    return -3;
+  }
+
+  fcb->read_addr = next;
+  if (fcb_lz_decompress(src + 2, item->len - 2U, (uint8_t *)buf, raw_len) !=
+      (int)raw_len)
+  {
+    return -4;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Copy the item at the read position into a buffer and advance past
+ * it.
+ *
+ * Compressed records are decompressed into the buffer.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param buf Destination buffer.
+ * @param buf_len Size of the destination buffer in bytes.
+ * @param len_out Optional pointer to store the record length.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no unread item,
+ * -3 if the buffer is too small, -4 if the payload failed its CRC check.
+ */
+int fcb_read(Fcb *fcb, void *buf, uint16_t buf_len, uint16_t *len_out)
+{
+  if (fcb == NULL || buf == NULL)
+  {
+    return -1;
+  }
+
+  /* Buffered items are served from RAM by fcb_flash_read() */
+  FcbItem item;
+  int rc = fcb_locate_read(fcb, &item);
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  if (item.flags & FCB_ITEM_COMPRESSED)
+  {
+    return fcb_read_packed(fcb, &item, buf, buf_len, len_out);
+  }
+
+  if (len_out != NULL)
+  {
+    *len_out = item.len;
+  }
+
+  if (item.len > buf_len)
+  {
+    return -3;
+  }
+
+  fcb_flash_read(fcb, item.addr, buf, item.len);
+  fcb->read_addr = fcb_align_up(fcb, item.addr + item.len);
+
+  if (fcb_crc32(0, buf, item.len) != item.crc)
+  {
+    return -4;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Mark the oldest item as consumed.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no item to pop.
+ */
+int fcb_pop(Fcb *fcb)
+{
+  if (fcb == NULL)
+  {
+    return -1;
+  }
+
+  struct ItemKey key;
+  uint32_t addr = fcb->delete_addr;
+
+  if (fcb_locate_item(fcb, &addr, &key) != 0)
+  {
+    return -2;
+  }
+
+  /* Clear the status to popped, a 1 -> 0 transition only */
+  uint32_t status = FCB_STATUS_POPPED;
+  fcb_flash_write(fcb, addr + offsetof(struct ItemKey, status), &status,
+              sizeof(status));
+
+  /* Move the delete position to the next live item (or the head) */
+  uint32_t old_delete = fcb->delete_addr;
+  addr += fcb_item_size(fcb, key.len);
+  fcb_locate_item(fcb, &addr, &key);
+
+  /* Retire every sector the delete position has left behind */
+  uint32_t sector_num = fcb_addr_sector(fcb, old_delete);
+  uint32_t new_sector = fcb_addr_sector(fcb, addr);
+  while (sector_num != new_sector)
+  {
+    if (!fcb_sector_is_skipped(fcb, sector_num))
+    {
+      fcb_set_sector_state(fcb, sector_num, STATE_CONSUMED);
+    }
+
+    sector_num++;
+    if (sector_num > fcb->last_sector)
+    {
+      sector_num = fcb->first_sector;
+    }
+  }
+
+  /* Items popped before being read drag the read position along */
+  if (fcb_ring_distance(fcb, old_delete, fcb->read_addr) <
+      fcb_ring_distance(fcb, old_delete, addr))
+  {
+    fcb->read_addr = addr;
+  }
+
+  fcb->delete_addr = addr;
+
+  return 0;
+}
+
+/**
+ * @brief Consume every item that starts before a given address.
+ *
+ * Sectors left entirely behind are retired with a single header write;
+ * only the items of the sector holding the limit get their status cleared.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param limit Absolute address in [delete_addr, write_addr].
+ */
+static void fcb_consume_to(Fcb *fcb, uint32_t limit)
+{
+  struct ItemKey key;
+  uint32_t old_delete = fcb->delete_addr;
+  uint32_t limit_sector = fcb_addr_sector(fcb, limit);
+  uint32_t addr;
+
+  if (limit_sector == fcb_addr_sector(fcb, old_delete))
+  {
+    addr = old_delete;
+  } else
+  {
+    addr = limit_sector * fcb->sector_size + fcb_data_start(fcb);
+  }
+
+  /* Pop the boundary items, the walk ends on the first item to keep */
+  uint32_t status = FCB_STATUS_POPPED;
+  while (fcb_locate_item(fcb, &addr, &key) == 0 &&
+         fcb_addr_sector(fcb, addr) == limit_sector && addr < limit)
+  {
+    fcb_flash_write(fcb, addr + offsetof(struct ItemKey, status), &status,
+                    sizeof(status));
+    addr += fcb_item_size(fcb, key.len);
+  }
+
+  /* Retire every sector the delete position has left behind */
+  uint32_t sector_num = fcb_addr_sector(fcb, old_delete);
+  uint32_t new_sector = fcb_addr_sector(fcb, addr);
+  while (sector_num != new_sector)
+  {
+    if (!fcb_sector_is_skipped(fcb, sector_num))
+    {
+      fcb_set_sector_state(fcb, sector_num, STATE_CONSUMED);
+    }
+
+    sector_num++;
+    if (sector_num > fcb->last_sector)
+    {
+      sector_num = fcb->first_sector;
+    }
+  }
+
+  if (fcb_ring_distance(fcb, old_delete, fcb->read_addr) <
+      fcb_ring_distance(fcb, old_delete, addr))
+  {
+    fcb->read_addr = addr;
+  }
+
+  fcb->delete_addr = addr;
+}
+
+/**
+ * @brief Consume every item that starts before a flash address.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute flash address.
+ * @return int 0 on success, -1 on invalid arguments, -2 if addr is outside
+ * the unconsumed part of the buffer.
+ */
+int fcb_consume_until(Fcb *fcb, uint32_t addr)
+{
+  if (fcb == NULL || fcb->dev == NULL)
+  {
+    return -1;
+  }
+
+  if (!fcb_addr_is_live(fcb, addr))
+  {
+    return -2;
+  }
+
+  fcb_consume_to(fcb, addr);
+
+  return 0;
+}
+
+/**
+ * @brief Consume every record numbered before a given record.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record First record number to keep.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the record has
+ * not been written yet or was lost.
+ */
+int fcb_consume_until_record(Fcb *fcb, uint32_t record)
+{
+  if (fcb == NULL || fcb->dev == NULL)
+  {
+    return -1;
+  }
+
+  uint32_t addr = fcb->write_addr;
+  if (SEQ_IS_NEWER(record, fcb->next_record))
+  {
+    return -2;
+  }
+
+  if (record != fcb->next_record && fcb_find_record(fcb, record, &addr) != 0)
+  {
+    /* Records older than the tail sector are consumed already */
+    uint32_t tail_sector = fcb_addr_sector(fcb, fcb->delete_addr);
+    return SEQ_IS_OLDER(record, fcb_sector_first_record(fcb, tail_sector))
+               ? 0
+               : -2;
+  }
+
+  if (fcb_addr_is_live(fcb, addr))
+  {
+    fcb_consume_to(fcb, addr);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Walk all unread items without consuming them.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param cb Callback invoked with the flash location of every item.
+ * @param arg User argument passed to the callback.
+ * @return int 0 when all items were visited, -1 on invalid arguments, or the
+ * non-zero value returned by the callback.
+ */
+int fcb_walk(Fcb *fcb, fcb_walk_cb cb, void *arg)
+{
+  if (fcb == NULL || cb == NULL)
+  {
+    return -1;
+  }
+
+  struct ItemKey key;
+  uint32_t addr = fcb->read_addr;
+
+  while (fcb_locate_item(fcb, &addr, &key) == 0)
+  {
+    FcbItem item;
+    item.addr = addr + sizeof(struct ItemKey);
+    item.len = key.len;
+    item.crc = key.crc;
+    item.flags = fcb_item_flags(&key);
+
+    if (fcb->wb_len > 0 && item.addr + item.len > fcb->wb_addr)
+    {
+      fcb_wb_commit(fcb, fcb->wb_len);
+    }
+
+    item.data = fcb_flash_map(fcb, item.addr, item.len);
+
+    int rc = cb(&item, arg);
+    if (rc != 0)
+    {
+      return rc;
+    }
+
+    addr = fcb_align_up(fcb, item.addr + item.len);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Locate a record among the live sectors.
+ *
+ * The sector is found by a binary search over the first record numbers of
+ * the sectors from the tail to the write sector, then walked on its own.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record Record number to look for (older than Fcb.next_record).
+ * @param addr_out Pointer to store the absolute address of the item, which
+ * may lie before the delete position.
+ * @return int 0 if the record was found, -2 otherwise.
+ */
+static int fcb_find_record(const Fcb *fcb, uint32_t record, uint32_t *addr_out)
+{
+  /* Live sectors, in ring order from the tail to the write sector */
+  uint32_t sector_count = fcb->last_sector - fcb->first_sector + 1;
+  uint32_t tail_sector = fcb_addr_sector(fcb, fcb->delete_addr);
+  uint32_t write_sector = fcb_addr_sector(fcb, fcb->write_addr);
+  uint32_t span = (write_sector + sector_count - tail_sector) % sector_count;
+
+  /* Last sector whose first record is not after the target */
+  uint32_t lo = 0;
+  uint32_t hi = span;
+  if (fcb->wear_skip != 0)
+  {
+    /* Skipped sectors keep stale record numbers, step over them in order */
+    for (uint32_t i = 1; i <= span; i++)
+    {
+      uint32_t sector = fcb->first_sector +
+                        (tail_sector - fcb->first_sector + i) % sector_count;
+
+      if (fcb_sector_is_skipped(fcb, sector))
+      {
+        continue;
+      }
+
+      if (SEQ_IS_NEWER(fcb_sector_first_record(fcb, sector), record))
+      {
+        break;
+      }
+
+      lo = i;
+    }
+
+    hi = lo;
+  }
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo + 1) / 2;
+    uint32_t sector = fcb->first_sector +
+                      (tail_sector - fcb->first_sector + mid) % sector_count;
+
+    if (SEQ_IS_NEWER(fcb_sector_first_record(fcb, sector), record))
+    {
+      hi = mid - 1;
+    } else
+    {
+      lo = mid;
+    }
+  }
+
+  uint32_t sector = fcb->first_sector +
+                    (tail_sector - fcb->first_sector + lo) % sector_count;
+  uint32_t first = fcb_sector_first_record(fcb, sector);
+  if (SEQ_IS_OLDER(record, first))
+  {
+    /* Older than anything still stored */
+    return -2;
+  }
+
+  uint32_t end = (sector == write_sector)
+                     ? fcb_addr_offset(fcb, fcb->write_addr)
+                     : fcb->sector_size;
+  uint32_t skip = record - first;
+
+  /* A sealed sector tells whether it holds the record without a walk */
+  SectorSummary summary;
+  if (fcb_read_summary(fcb, sector, &summary) == 0)
+  {
+    if (skip >= summary.record_count)
+    {
+      return -2;
+    }
+
+    end = summary.used;
+  }
+
+  /* Walk only inside the sector */
+  struct ItemKey key;
+  uint32_t offset = fcb_data_start(fcb);
+  while (fcb_record_at(fcb, sector, end, &offset, &key) == 0)
+  {
+    if (skip == 0)
+    {
+      *addr_out = sector * fcb->sector_size + offset;
+      return 0;
+    }
+
+    skip--;
+    offset += fcb_item_size(fcb, key.len);
+  }
+
+  return -2;
+}
+
+/**
+ * @brief Check that an address lies in the unconsumed part of the ring.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr The absolute address to check.
+ * @return int 1 if addr is in [delete_addr, write_addr] and not in a skipped
+ * sector, 0 otherwise.
+ */
+static int fcb_addr_is_live(const Fcb *fcb, uint32_t addr)
+{
+  if (fcb->wear_skip != 0 &&
+      fcb_sector_is_skipped(fcb, fcb_addr_sector(fcb, addr)))
+  {
+    return 0;
+  }
+
+  return fcb_ring_distance(fcb, fcb->delete_addr, addr) <=
+         fcb_ring_distance(fcb, fcb->delete_addr, fcb->write_addr);
+}
+
+/**
+ * @brief Move the read position to a given record.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record Record number to read next.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the record has
+ * already been consumed, was lost or has not been written yet.
+ */
+int fcb_seek(Fcb *fcb, uint32_t record)
+{
+  if (fcb == NULL || fcb->dev == NULL)
+  {
+    return -1;
+  }
+
+  uint32_t addr;
+  if (!SEQ_IS_OLDER(record, fcb->next_record) ||
+      fcb_find_record(fcb, record, &addr) != 0)
+  {
+    return -2;
+  }
+
+  /* Records before the delete position are gone */
+  if (addr == fcb->write_addr || !fcb_addr_is_live(fcb, addr))
+  {
+    return -2;
+  }
+
+  fcb->read_addr = addr;
+
+  return 0;
+}
+
+/**
+ * @brief Record number of the item the next read returns.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record Pointer to store the record number; when there is no unread
+ * item this is the number the next appended item gets.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_tell(Fcb *fcb, uint32_t *record)
+{
+  if (fcb == NULL || fcb->dev == NULL || record == NULL)
+  {
+    return -1;
+  }
+
+  FcbItem item;
+  if (fcb_locate_read(fcb, &item) != 0)
+  {
+    *record = fcb->next_record;
+    return 0;
+  }
+
+  *record = fcb_record_of(fcb, fcb->read_addr);
+
+  return 0;
+}
+
+/**
+ * @brief Start an empty stage at the write address.
+ *
+ * @param stage Pointer to the staging buffer.
+ */
+static void fcb_stage_init(const Fcb *fcb, FcbStage *stage)
+{
+  stage->addr = fcb->write_addr;
+  stage->len = 0;
+  stage->size = (fcb->dev->page_size < FCB_STAGE_SIZE) ? fcb->dev->page_size
+                                                        : FCB_STAGE_SIZE;
+  stage->rc = 0;
+  stage->err_addr = 0;
+  stage->err_end = 0;
+}
+
+/**
+ * @brief Program a block of the stage, unless an earlier program failed.
+ *
+ * @param stage Pointer to the staging buffer.
+ * @param data Source data, programmed at stage->addr.
+ * @param len Number of bytes to program.
+ */
+static void fcb_stage_program(Fcb *fcb, FcbStage *stage, const void *data,
+                              uint32_t len)
+{
+  if (stage->rc != 0)
+  {
+    return;
+  }
+
+  stage->rc = fcb_flash_write(fcb, stage->addr, data, len);
+  if (stage->rc != 0)
+  {
+    stage->err_addr = stage->addr;
+    stage->err_end = stage->addr + len;
+  }
+}
+
+/**
+ * @brief Program any staged bytes and restart the stage after them.
+ *
+ * @param stage Pointer to the staging buffer.
+ */
+static void fcb_stage_flush(Fcb *fcb, FcbStage *stage)
+{
+  if (stage->len > 0)
+  {
+    fcb_stage_program(fcb, stage, stage->buf, stage->len);
+    stage->addr += stage->len;
+    stage->len = 0;
+  }
+}
+
+/**
+ * @brief Append bytes to the staging buffer, programming full pages.
+ *
+ * Data that covers whole pages while the stage is empty is programmed
+ * straight from the source buffer.
+ *
+ * @param stage Pointer to the staging buffer.
+ * @param data Source data.
+ * @param len Number of bytes to stage.
+ */
+static void fcb_stage_write(Fcb *fcb, FcbStage *stage, const void *data,
+                            uint32_t len)
+{
+  const uint8_t *src = (const uint8_t *)data;
+
+  while (len > 0)
+  {
+    uint32_t page_room =
+        stage->size - ((stage->addr + stage->len) % stage->size);
+
+    if (stage->len == 0 && page_room == stage->size && len >= stage->size)
+    {
+      /* Page aligned and at least one full page: bypass the copy */
+      uint32_t direct = len - (len % stage->size);
+      fcb_stage_program(fcb, stage, src, direct);
+      stage->addr += direct;
+      src += direct;
+      len -= direct;
+      continue;
+    }
+
+    uint32_t chunk = (len < page_room) ? len : page_room;
+    memcpy(&stage->buf[stage->len], src, chunk);
+    stage->len += chunk;
+    src += chunk;
+    len -= chunk;
+
+    if (chunk == page_room)
+    {
+      fcb_stage_flush(fcb, stage);
+    }
+  }
+}
+
+/**
+ * @brief Append several items to the FCB in a single programming pass.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param iov Array of items to append.
+ * @param cnt Number of entries in the array.
+ * @return int Number of items committed, -1 on invalid arguments, -3 if a
+ * flash error stopped the batch before any item was committed.
+ */
+int fcb_append_batch(Fcb *fcb, const FcbIovec *iov, size_t cnt)
+{
+  if (fcb == NULL || iov == NULL)
+  {
+    return -1;
+  }
+
+  FcbStage stage;
+  fcb_stage_init(fcb, &stage);
+
+  uint8_t fill[FCB_ALIGN_MAX];
+  memset(fill, 0xFF, sizeof(fill));
+
+  /* Staged items not known to be programmed yet, oldest first */
+  struct
+  {
+    uint32_t end;     /* Flash address after the item */
+    uint16_t raw_len; /* Record length for the statistics */
+  } pending[FCB_STAGE_ITEMS];
+  uint32_t pending_head = 0;
+  uint32_t pending_count = 0;
+  uint32_t done_addr = fcb->write_addr; /* Start of the oldest pending item */
+
+  int wb = fcb_wb_enabled(fcb);
+  int committed = 0;
+  int rc = 0;
+
+  for (size_t i = 0; i < cnt; i++)
+  {
+    const void *data = iov[i].iov_base;
+    uint16_t len = iov[i].iov_len;
+    if (data == NULL || len == 0)
+    {
+      break;
+    }
+
+    uint16_t raw_len = len;
+    uint16_t flags = fcb_lz_pack(fcb, &data, &len);
+
+    uint32_t item_size = fcb_item_size(fcb, len);
+    uint32_t offset_in_sector = fcb_addr_offset(fcb, fcb->write_addr);
+
+    if (offset_in_sector + item_size >= fcb->sector_size)
+    {
+      /* Program what belongs to the current sector before moving on */
+      fcb_stage_flush(fcb, &stage);
+      if (stage.rc != 0)
+      {
+        break;
+      }
+
+      for (; pending_count > 0; pending_count--)
+      {
+        fcb->stat_appended += pending[pending_head].raw_len;
+        pending_head = (pending_head + 1) % FCB_STAGE_ITEMS;
+        committed++;
+      }
+
+      rc = fcb_prepare_write(fcb, item_size);
+      if (rc != 0)
+      {
+        break;
+      }
+
+      stage.addr = fcb->write_addr;
+      done_addr = fcb->write_addr;
+    }
+
+    struct ItemKey key;
+    key.magic = FCB_ENTRY_MAGIC & ~flags;
+    key.len = len;
+    key.crc = fcb_crc32(0, data, len);
+    key.status = FCB_STATUS_VALID;
+
+    uint32_t pad = item_size - sizeof(struct ItemKey) - len;
+
+    FcbIovec part;
+    part.iov_base = data;
+    part.iov_len = len;
+    fcb_cache_insert(fcb, fcb->write_addr, &key, &part, 1);
+
+    if (wb)
+    {
+      /* As with fcb_append(), the item whose bytes meet the error fails */
+      rc = fcb_wb_write(fcb, fcb->write_addr, &key, sizeof(struct ItemKey));
+      int err = fcb_wb_write(fcb, fcb->write_addr + sizeof(struct ItemKey),
+                             data, len);
+      rc = (rc != 0) ? rc : err;
+      err = fcb_wb_write(fcb, fcb->write_addr + sizeof(struct ItemKey) + len,
+                         fill, pad);
+      rc = (rc != 0) ? rc : err;
+
+      fcb->write_addr += item_size;
+      fcb->next_record++;
+      fcb->stat_appended += raw_len;
+      if (rc != 0)
+      {
+        break;
+      }
+
+      committed++;
+      continue;
+    }
+
+    fcb_stage_write(fcb, &stage, &key, sizeof(struct ItemKey));
+    fcb_stage_write(fcb, &stage, data, len);
+    fcb_stage_write(fcb, &stage, fill, pad);
+
+    fcb->write_addr += item_size;
+    fcb->next_record++;
+
+    uint32_t slot = (pending_head + pending_count) % FCB_STAGE_ITEMS;
+    pending[slot].end = fcb->write_addr;
+    pending[slot].raw_len = raw_len;
+    pending_count++;
+
+    if (stage.rc != 0)
+    {
+      break;
+    }
+
+    /* Everything before the stage has been programmed */
+    while (pending_count > 0 && pending[pending_head].end <= stage.addr)
+    {
+      done_addr = pending[pending_head].end;
+      fcb->stat_appended += pending[pending_head].raw_len;
+      pending_head = (pending_head + 1) % FCB_STAGE_ITEMS;
+      pending_count--;
+      committed++;
+    }
+  }
+
+  if (wb)
+  {
+    if (rc == 0 && fcb_wb_apply_policy(fcb) != 0)
+    {
+      /* The policy ran for the last item, which takes the error */
+      rc = -3;
+      committed -= (committed > 0) ? 1 : 0;
+    }
+  } else
+  {
+    fcb_stage_flush(fcb, &stage);
+
+    /*
+     * Items before the failed program are complete, and so are the ones it
+     * still finished: the program stopped somewhere inside its range.
+     */
+    uint32_t good = (stage.rc != 0) ? stage.err_addr : stage.addr;
+    while (pending_count > 0 &&
+           (pending[pending_head].end <= good ||
+            (pending[pending_head].end <= stage.err_end &&
+             fcb_item_is_intact(fcb, done_addr))))
+    {
+      done_addr = pending[pending_head].end;
+      fcb->stat_appended += pending[pending_head].raw_len;
+      pending_head = (pending_head + 1) % FCB_STAGE_ITEMS;
+      pending_count--;
+      committed++;
+    }
+
+    if (pending_count > 0)
     {
-      /* Potential head candidates found, check if there's enough FF space */
-      int is_ff = 1;
-      for (uint32_t i = 1; i < threshold / 4; i++)
+      /* Skip the items the failed program touched, take back the rest */
+      uint32_t touched = 0;
+      uint32_t start = done_addr;
+      uint32_t resume = done_addr;
+      while (touched < pending_count)
       {
-        uint32_t next_word;
-        flash_read(sector_addr + offset + (i * 4), &next_word,
-                   sizeof(next_word));
-        if (next_word != 0xFFFFFFFF)
+        uint32_t slot = (pending_head + touched) % FCB_STAGE_ITEMS;
+        fcb->stat_appended += pending[slot].raw_len;
+        start = resume;
+        resume = pending[slot].end;
+        touched++;
+        if (resume >= stage.err_end)
         {
-          is_ff = 0;
           break;
         }
       }
 
-      if (is_ff)
+      /*
+       * Readers step over the last touched item by its length if its key
+       * made it, otherwise they resync, which must not run into erased
+       * space: continue right after the failed program then.
+       */
+      if (start + sizeof(struct ItemKey) > stage.err_addr)
       {
-        return offset;
+        resume = stage.err_end;
       }
 
-      /* Advance by 1 byte since we found a non-FF word or it's not a full FF block */
-      offset += 1;
-    }
-    else
-    {
-      struct ItemKey key;
-      if (fcb_read_item_at(sector_addr + offset, &key) == 0)
-      {
-        /* Valid item, skip it */
-        offset += sizeof(struct ItemKey) + key.len;
-      } else
-      {
-        /* Corrupted or non-FF data, jump to next byte */
-        offset += 1;
-      }
-    }
+      fcb->next_record -= pending_count - touched;
+      fcb->write_addr = resume;
+      rc = -3;
+    }
+  }
+
+  if (committed == 0 && rc == -3)
+  {
+    return -3;
+  }
+
+  return committed;
+}
+
+/**
+ * @brief Find the index slot of a record ID.
+ *
+ * Open addressing with linear probing; slots are never freed, so a probe
+ * ends at the first free slot.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param id Record ID.
+ * @param insert Non-zero to return the free slot ending the probe when the
+ * ID is not indexed.
+ * @return FcbKvSlot* The slot, or NULL if the ID is not indexed (and, with
+ * insert, the index is full).
+ */
+static FcbKvSlot *fcb_kv_slot(const Fcb *fcb, uint16_t id, int insert)
+{
+  uint32_t mask = fcb->kv_slots - 1;
+  uint32_t i = ((uint32_t)id * 40503u) & mask;
+
+  for (uint32_t n = 0; n < fcb->kv_slots; n++)
+  {
+    FcbKvSlot *slot = &fcb->kv_index[i];
+    if (slot->addr == 0)
+    {
+      return insert ? slot : NULL;
+    }
+
+    if (slot->id == id)
+    {
+      return slot;
+    }
+
+    i = (i + 1) & mask;
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Read the record ID of a keyed item.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Address of the item's ItemKey.
+ * @param key The ItemKey of the item.
+ * @param id_out Pointer to store the record ID.
+ * @return int 0 on success, -2 if the item is not a keyed record.
+ */
+static int fcb_kv_id(const Fcb *fcb, uint32_t addr, const struct ItemKey *key,
+                     uint16_t *id_out)
+{
+  uint8_t raw[2];
+
+  if ((key->magic & FCB_KEY_FLAG_ID) != 0 || key->len < sizeof(raw) ||
+      fcb_flash_read(fcb, addr + sizeof(struct ItemKey), raw, sizeof(raw)) !=
+          0)
+  {
+    return -2;
   }
 
-  return 0xFFFFFFFF;
+  *id_out = (uint16_t)(raw[0] | (raw[1] << 8));
+
+  return 0;
 }
 
 /**
- * @brief Find the first valid ItemKey in a sector.
+ * @brief Rebuild the keyed record index from the unconsumed items.
  *
- * @param sector_num The index of the sector to scan.
- * @return uint32_t The sector-relative offset of the first valid item, or
- * 0xFFFFFFFF if none.
+ * IDs that do not fit in a full index are left out.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
  */
-static uint32_t fcb_find_sector_tail_offset(uint32_t sector_num)
+static void fcb_kv_build(Fcb *fcb)
 {
-  uint32_t sector_addr = sector_num * FLASH_SECTOR_SIZE;
-  uint32_t offset = sizeof(SectorHeader);
+  if (fcb->kv_index == NULL)
+  {
+    return;
+  }
+
+  memset(fcb->kv_index, 0, fcb->kv_slots * sizeof(FcbKvSlot));
+
   struct ItemKey key;
+  uint32_t addr = fcb->delete_addr;
 
-  while (offset + sizeof(struct ItemKey) <= FLASH_SECTOR_SIZE)
+  while (fcb_locate_item(fcb, &addr, &key) == 0)
   {
-    if (fcb_read_item_at(sector_addr + offset, &key) == 0)
-    {
-      return offset;
-    }
+    uint16_t id;
+    FcbKvSlot *slot;
 
-    /* Check if we hit FF area - if so, no point continuing */
-    uint32_t word;
-    flash_read(sector_addr + offset, &word, sizeof(word));
-    if (word == 0xFFFFFFFF)
+    if (fcb_kv_id(fcb, addr, &key, &id) == 0 &&
+        (slot = fcb_kv_slot(fcb, id, 1)) != NULL)
     {
-      break;
+      slot->id = id;
+      slot->addr = addr;
     }
 
-    /* Jump to next byte */
-    offset += 1;
+    addr += fcb_item_size(fcb, key.len);
   }
-
-  return 0xFFFFFFFF;
 }
 
 /**
- * @brief Recover the global tail by finding the first valid item across
- * sectors.
+ * @brief Drop the index slots of a sector about to be erased.
  *
- * @param fcb Pointer to FCB structure.
- * @param head_addr The current absolute head address.
- * @return uint32_t The absolute address of the tail, or head_addr if no valid
- * items found.
+ * A slot points at the latest record of its ID, so the ID keeps no record
+ * once the sector goes. The slot stays taken to keep the probes through it
+ * intact and is reused by the next fcb_put() of the same ID.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param sector_num The index of the sector.
  */
-static uint32_t fcb_recover_global_tail(Fcb *fcb, uint32_t head_addr)
+static void fcb_kv_drop_sector(Fcb *fcb, uint32_t sector_num)
 {
-  int head_sector = (int)(head_addr / FLASH_SECTOR_SIZE);
-  int tail_sector = -1;
-  int dummy_head = -1;
-  uint32_t highest_seq = 0;
+  if (fcb->kv_index == NULL)
+  {
+    return;
+  }
 
-  /* Find relative oldest sector */
-  fcb_find_head_tail(fcb, &dummy_head, &tail_sector, &highest_seq);
+  for (uint32_t i = 0; i < fcb->kv_slots; i++)
+  {
+    FcbKvSlot *slot = &fcb->kv_index[i];
+    if (slot->addr != 0 && slot->addr != FCB_KV_DROPPED &&
+        fcb_addr_sector(fcb, slot->addr) == sector_num)
+    {
+      slot->addr = FCB_KV_DROPPED;
+    }
+  }
+}
 
-  if (tail_sector == -1)
+/**
+ * @brief Copy an item to the write address as is.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Address of the item's ItemKey.
+ * @param key The ItemKey of the item.
+ * @param addr_out Pointer to store the address of the copy.
+ * @return int 0 on success, -2 if it does not fit in the write sector, -3 on
+ * flash error (the copy is skipped by the readers).
+ */
+static int fcb_kv_copy(Fcb *fcb, uint32_t addr, const struct ItemKey *key,
+                       uint32_t *addr_out)
+{
+  uint32_t item_size = fcb_item_size(fcb, key->len);
+  if (fcb_addr_offset(fcb, fcb->write_addr) + item_size >= fcb->sector_size)
   {
-    return head_addr;
+    return -2;
   }
 
-  /* Scan sectors starting from tail_sector towards head_sector */
-  uint32_t sector_count = fcb->last_sector - fcb->first_sector + 1;
-  uint32_t i = (uint32_t)tail_sector;
+  FcbStage stage;
+  fcb_stage_init(fcb, &stage);
 
-  for (uint32_t count = 0; count < sector_count; count++)
+  fcb_stage_write(fcb, &stage, key, sizeof(struct ItemKey));
+
+  /* The payload moves in chunks, its CRC in the key stays valid */
+  uint8_t chunk[FCB_SCAN_CHUNK];
+  uint32_t src = addr + sizeof(struct ItemKey);
+  uint32_t left = key->len;
+  while (left > 0)
   {
-    uint32_t offset = fcb_find_sector_tail_offset(i);
-    if (offset != 0xFFFFFFFF)
+    uint32_t n = (left < sizeof(chunk)) ? left : sizeof(chunk);
+    if (fcb_flash_read(fcb, src, chunk, n) != 0)
     {
-      return i * FLASH_SECTOR_SIZE + offset;
+      stage.rc = -3;
     }
 
-    /* If we reached the head sector and found nothing, stop */
-    if ((int)i == head_sector)
-    {
-      break;
-    }
+    fcb_stage_write(fcb, &stage, chunk, n);
+    src += n;
+    left -= n;
+  }
 
-    i++;
-    if (i > fcb->last_sector)
+  uint8_t fill[FCB_ALIGN_MAX];
+  uint32_t pad = item_size - sizeof(struct ItemKey) - key->len;
+  memset(fill, 0xFF, pad);
+  fcb_stage_write(fcb, &stage, fill, pad);
+  fcb_stage_flush(fcb, &stage);
+
+  *addr_out = fcb->write_addr;
+  fcb->write_addr += item_size;
+  fcb->next_record++;
+
+  return (stage.rc == 0) ? 0 : -3;
+}
+
+/**
+ * @brief Collect the oldest sector ahead of the writer in keyed mode.
+ *
+ * The latest record of every ID found there is copied to the write sector,
+ * superseded records are dropped and unconsumed plain records are counted
+ * as overwritten. If the write sector fills up, the delete position stops
+ * at the first record not copied yet.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ */
+static void fcb_kv_collect(Fcb *fcb)
+{
+  uint32_t tail_sector = fcb_addr_sector(fcb, fcb->delete_addr);
+  if (tail_sector == fcb_addr_sector(fcb, fcb->write_addr))
+  {
+    return;
+  }
+
+  struct ItemKey key;
+  uint32_t old_delete = fcb->delete_addr;
+  uint32_t addr = old_delete;
+  int done = 1;
+
+  /* fcb_locate_item() leaves addr on the first live item after the sector */
+  while (fcb_locate_item(fcb, &addr, &key) == 0 &&
+         fcb_addr_sector(fcb, addr) == tail_sector)
+  {
+    uint16_t id;
+    FcbKvSlot *slot;
+
+    if (fcb_kv_id(fcb, addr, &key, &id) != 0)
     {
-      i = fcb->first_sector;
+      fcb->overwritten++;
+    } else if ((slot = fcb_kv_slot(fcb, id, 0)) != NULL && slot->addr == addr)
+    {
+      uint32_t copy;
+      int rc = fcb_kv_copy(fcb, addr, &key, &copy);
+      if (rc == -2)
+      {
+        done = 0;
+        break;
+      }
+
+      if (rc == 0)
+      {
+        slot->addr = copy;
+      }
     }
+
+    addr += fcb_item_size(fcb, key.len);
   }
 
-  return head_addr;
+  if (done)
+  {
+    fcb_set_sector_state(fcb, tail_sector, STATE_CONSUMED);
+  }
+
+  if (fcb_ring_distance(fcb, old_delete, fcb->read_addr) <
+      fcb_ring_distance(fcb, old_delete, addr))
+  {
+    fcb->read_addr = addr;
+  }
+
+  fcb->delete_addr = addr;
 }
 
 /**
- * @brief Initialize the FCB by scanning the flash sectors.
+ * @brief Append a keyed record, superseding earlier ones with the same ID.
  *
  * @param fcb Pointer to the FCB logistics structure.
- * @return int 0 on success, non-zero error code otherwise.
+ * @param id Record ID.
+ * @param data Pointer to the value, may be NULL if len is 0.
+ * @param len Length of the value in bytes, at most 65533.
+ * @return int 0 on success, -1 on invalid arguments or if keyed mode is
+ * off, -2 if the index has no room for a new ID or the buffer is full,
+ * otherwise as fcb_append().
  */
-int fcb_mount(Fcb *fcb)
+int fcb_put(Fcb *fcb, uint16_t id, const void *data, uint16_t len)
 {
-  if (fcb == NULL)
+  if (fcb == NULL || fcb->dev == NULL || fcb->kv_index == NULL ||
+      (data == NULL && len > 0) || len > 0xFFFF - 2)
   {
     return -1;
   }
 
-  uint32_t highest_seq;
-  int head_sector;
-  int tail_sector;
+  /* Slots are never moved, so this one stays valid across a collection */
+  FcbKvSlot *slot = fcb_kv_slot(fcb, id, 1);
+  if (slot == NULL)
+  {
+    return -2;
+  }
 
-  fcb_find_head_tail(fcb, &head_sector, &tail_sector, &highest_seq);
+  uint8_t prefix[2];
+  prefix[0] = (uint8_t)(id & 0xFF);
+  prefix[1] = (uint8_t)(id >> 8);
 
-  if (head_sector == -1)
+  FcbIovec parts[2];
+  parts[0].iov_base = prefix;
+  parts[0].iov_len = sizeof(prefix);
+  parts[1].iov_base = data;
+  parts[1].iov_len = len;
+
+  int rc = fcb_write_item(fcb, FCB_KEY_FLAG_ID, parts, (len > 0) ? 2 : 1,
+                          len);
+  if (rc == 0)
   {
-    /* No active sectors found, start with the first sector */
-    fcb->current_sector_id = 0;
-    fcb->write_addr =
-        fcb->first_sector * FLASH_SECTOR_SIZE + sizeof(SectorHeader);
-    fcb->read_addr = fcb->write_addr;
-    fcb->delete_addr = fcb->write_addr;
+    slot->id = id;
+    slot->addr = fcb->write_addr - fcb_item_size(fcb, sizeof(prefix) + len);
+  }
 
-    return 0;
+  return rc;
+}
+
+/**
+ * @brief Read the latest value stored for a record ID.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param id Record ID.
+ * @param buf Buffer to store the value, may be NULL if buf_len is 0.
+ * @param buf_len Size of the buffer in bytes.
+ * @param len_out Pointer to store the length of the value, may be NULL.
+ * @return int 0 on success, -1 on invalid arguments or if keyed mode is
+ * off, -2 if the ID has no live record, -3 if the buffer is too small, -4 if
+ * the CRC check fails.
+ */
+int fcb_get_latest(Fcb *fcb, uint16_t id, void *buf, uint16_t buf_len,
+                   uint16_t *len_out)
+{
+  if (fcb == NULL || fcb->dev == NULL || fcb->kv_index == NULL ||
+      (buf == NULL && buf_len > 0))
+  {
+    return -1;
   }
 
-  fcb->current_sector_id = highest_seq;
+  struct ItemKey key;
+  uint16_t stored_id;
+  FcbKvSlot *slot = fcb_kv_slot(fcb, id, 0);
 
-  /* Recover head position in the newer sector */
-  uint32_t head_offset = fcb_find_sector_head_offset((uint32_t)head_sector);
+  if (slot == NULL || slot->addr == FCB_KV_DROPPED ||
+      fcb->write_addr == fcb->delete_addr || slot->addr == fcb->write_addr ||
+      !fcb_addr_is_live(fcb, slot->addr) ||
+      fcb_read_item_at(fcb, slot->addr, &key) != 0 ||
+      key.status == FCB_STATUS_POPPED ||
+      fcb_kv_id(fcb, slot->addr, &key, &stored_id) != 0 || stored_id != id)
+  {
+    return -2;
+  }
 
-  if (head_offset == 0xFFFFFFFF)
+  uint16_t len = (uint16_t)(key.len - 2);
+  if (len_out != NULL)
+  {
+    *len_out = len;
+  }
+
+  if (len > buf_len)
+  {
+    return -3;
+  }
+
+  /* fcb_kv_id() matched the stored prefix against id */
+  uint8_t prefix[2];
+  prefix[0] = (uint8_t)(id & 0xFF);
+  prefix[1] = (uint8_t)(id >> 8);
+
+  uint32_t addr = slot->addr + sizeof(struct ItemKey) + sizeof(prefix);
+  if (len > 0 && fcb_flash_read(fcb, addr, buf, len) != 0)
+  {
+    return -3;
+  }
+
+  uint32_t crc = fcb_crc32(0, prefix, sizeof(prefix));
+  if (len > 0)
+  {
+    crc = fcb_crc32(crc, buf, len);
+  }
+
+  if (crc != key.crc)
+  {
+    return -4;
+  }
+
+  return 0;
+}
+
+/*============================================================================
+ * Export
+ *
+ * fcb_export() turns the unconsumed items into a stream of frames for bulk
+ * upload. The stream position is an item address plus its record number;
+ * the record number alone is enough to find the position again, so it
+ * serves as the resume cookie.
+ *============================================================================*/
+
+/**
+ * @brief Find the next item of an export stream that is not popped.
+ *
+ * Walks like fcb_locate_item(), but steps over popped items one by one so
+ * that the record number of the stream stays in step with its address.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param exp Export stream, moved to the item found or to the write
+ * position.
+ * @param key_out Pointer to store the ItemKey of the item found.
+ * @return int 0 if an item was found, -2 otherwise.
+ */
+static int fcb_export_locate(const Fcb *fcb, FcbExport *exp,
+                             struct ItemKey *key_out)
+{
+  uint32_t write_sector = fcb_addr_sector(fcb, fcb->write_addr);
+
+  while (exp->addr != fcb->write_addr)
   {
-    /* No FF space left in the newer sector, move to the next sector */
-    uint32_t next_sector = (uint32_t)head_sector + 1;
-    if (next_sector > fcb->last_sector)
+    uint32_t sector_num = fcb_addr_sector(fcb, exp->addr);
+    uint32_t offset = fcb_addr_offset(fcb, exp->addr);
+    uint32_t end = fcb->sector_size;
+    SectorSummary summary;
+
+    if (sector_num == write_sector)
     {
-      next_sector = fcb->first_sector;
+      end = fcb_addr_offset(fcb, fcb->write_addr);
+    } else if (fcb_read_summary(fcb, sector_num, &summary) == 0)
+    {
+      /* Nothing to scan past the last item of a sealed sector */
+      end = summary.used;
     }
 
-    /* Initialize the new head sector (Acceptable side-effect) */
-    flash_erase_sector(next_sector * FLASH_SECTOR_SIZE);
-    fcb_append_sector(fcb, next_sector);
-    fcb->write_addr = next_sector * FLASH_SECTOR_SIZE + sizeof(SectorHeader);
-  } else
+    if (fcb_record_at(fcb, sector_num, end, &offset, key_out) == 0)
+    {
+      exp->addr = sector_num * fcb->sector_size + offset;
+      if (key_out->status != FCB_STATUS_POPPED)
+      {
+        return 0;
+      }
+
+      exp->addr += fcb_item_size(fcb, key_out->len);
+      exp->record++;
+      continue;
+    }
+
+    if (sector_num == write_sector)
+    {
+      break;
+    }
+
+    /* End of data in this sector, continue in the next one in use */
+    uint32_t next_sector = fcb_next_sector(fcb, sector_num);
+    while (next_sector != write_sector &&
+           fcb_sector_is_skipped(fcb, next_sector))
+    {
+      next_sector = fcb_next_sector(fcb, next_sector);
+    }
+
+    exp->addr = next_sector * fcb->sector_size + fcb_data_start(fcb);
+    exp->record = fcb_sector_first_record(fcb, next_sector);
+  }
+
+  exp->addr = fcb->write_addr;
+  exp->record = fcb->next_record;
+  return -2;
+}
+
+/**
+ * @brief Start an export stream at the read position.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param exp Export stream to initialise.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_export_begin(Fcb *fcb, FcbExport *exp)
+{
+  if (fcb == NULL || fcb->dev == NULL || exp == NULL)
   {
-    fcb->write_addr = (uint32_t)head_sector * FLASH_SECTOR_SIZE + head_offset;
+    return -1;
   }
 
-  /* Recover tail position (first valid ItemKey across sectors) */
-  fcb->read_addr = fcb_recover_global_tail(fcb, fcb->write_addr);
-  fcb->delete_addr = fcb->read_addr;
+  struct ItemKey key;
+  exp->addr = fcb->read_addr;
+  if (fcb_locate_item(fcb, &exp->addr, &key) != 0)
+  {
+    exp->record = fcb->next_record;
+    return 0;
+  }
+
+  exp->record = fcb_record_of(fcb, exp->addr);
 
   return 0;
 }
 
 /**
- * @brief Erase all sectors associated with the FCB and reset its state.
+ * @brief Restart an export stream at a record.
  *
  * @param fcb Pointer to the FCB logistics structure.
- * @return int 0 on success, non-zero error code otherwise.
+ * @param exp Export stream to initialise.
+ * @param cookie Record number to export next.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the record has
+ * been consumed, was lost or has not been written yet.
  */
-int fcb_erase(Fcb *fcb)
+int fcb_export_resume(Fcb *fcb, FcbExport *exp, uint32_t cookie)
 {
-  if (fcb == NULL)
+  if (fcb == NULL || fcb->dev == NULL || exp == NULL)
   {
     return -1;
   }
 
-  /* Reset internally tracked sector state */
-  fcb->current_sector_id = 0;
-
-  /* Erase all sectors in the FCB range */
-  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  uint32_t addr = fcb->write_addr;
+  if (cookie != fcb->next_record)
   {
-    flash_erase_sector(i * FLASH_SECTOR_SIZE);
+    if (!SEQ_IS_OLDER(cookie, fcb->next_record) ||
+        fcb_find_record(fcb, cookie, &addr) != 0 ||
+        addr == fcb->write_addr || !fcb_addr_is_live(fcb, addr))
+    {
+      return -2;
+    }
   }
 
-  /* Re-initialize tracking addresses to the start of the first sector */
-  fcb->write_addr =
-      fcb->first_sector * FLASH_SECTOR_SIZE + sizeof(SectorHeader);
-  fcb->read_addr = fcb->write_addr;
-  fcb->delete_addr = fcb->write_addr;
+  exp->addr = addr;
+  exp->record = cookie;
 
   return 0;
 }
+
 /**
- * @brief Append an item to the FCB.
+ * @brief Fill a buffer with the next frames of an export stream.
  *
  * @param fcb Pointer to the FCB logistics structure.
- * @param data Pointer to the data to be written.
- * @param len Length of the data in bytes.
- * @return int 0 on success, non-zero error code otherwise.
+ * @param exp Export stream, advanced past the frames returned.
+ * @param buf Destination buffer.
+ * @param buf_len Size of the buffer in bytes.
+ * @param len_out Pointer to store the number of bytes filled, 0 once the
+ * stream has caught up with the write position.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the items at the
+ * stream position have been consumed since, -3 if the next frame does not
+ * fit into the buffer or on flash read error.
  */
-int fcb_append(Fcb *fcb, const void *data, uint16_t len)
+int fcb_export(Fcb *fcb, FcbExport *exp, void *buf, uint32_t buf_len,
+               uint32_t *len_out)
 {
-  if (fcb == NULL || data == NULL || len == 0)
+  if (fcb == NULL || fcb->dev == NULL || exp == NULL ||
+      (buf == NULL && buf_len > 0) || len_out == NULL)
   {
     return -1;
   }
 
-  uint32_t item_size = sizeof(struct ItemKey) + len;
+  *len_out = 0;
+  if (!fcb_addr_is_live(fcb, exp->addr))
+  {
+    return -2;
+  }
 
-  /* Check if current sector has room for the item */
-  uint32_t current_sector_num = fcb->write_addr / FLASH_SECTOR_SIZE;
-  uint32_t offset_in_sector = fcb->write_addr % FLASH_SECTOR_SIZE;
+  uint8_t *out = buf;
+  uint32_t used = 0;
+  struct ItemKey key;
 
-  if (offset_in_sector + item_size > FLASH_SECTOR_SIZE)
+  while (fcb_export_locate(fcb, exp, &key) == 0)
   {
-    /* Not enough space in current sector, move to the next one */
-    uint32_t next_sector = current_sector_num + 1;
-    if (next_sector > fcb->last_sector)
+    uint32_t frame = FCB_EXPORT_HDR_SIZE + key.len;
+    if (frame > buf_len - used)
     {
-      next_sector = fcb->first_sector;
+      /* Only whole frames go out, the rest waits for the next chunk */
+      if (used == 0)
+      {
+        return -3;
+      }
+
+      break;
     }
 
-    /* Check if we are about to overwrite the oldest sector (tail) */
-    uint32_t tail_sector = fcb->read_addr / FLASH_SECTOR_SIZE;
-    if (next_sector == tail_sector)
+    uint8_t *hdr = out + used;
+    uint16_t flags = fcb_item_flags(&key);
+    hdr[0] = (uint8_t)(key.len & 0xFF);
+    hdr[1] = (uint8_t)(key.len >> 8);
+    hdr[2] = (uint8_t)(flags & 0xFF);
+    hdr[3] = (uint8_t)(flags >> 8);
+    for (int i = 0; i < 4; i++)
     {
-      /* Buffer is full */
-      return -2;
+      hdr[4 + i] = (uint8_t)(exp->record >> (8 * i));
+      hdr[8 + i] = (uint8_t)(key.crc >> (8 * i));
     }
 
-    /* Erase and initialize the new sector */
-    flash_erase_sector(next_sector * FLASH_SECTOR_SIZE);
-    fcb_append_sector(fcb, next_sector);
+    if (key.len > 0 &&
+        fcb_flash_read(fcb, exp->addr + sizeof(struct ItemKey),
+                       hdr + FCB_EXPORT_HDR_SIZE, key.len) != 0)
+    {
+      *len_out = used;
+      return -3;
+    }
 
-    /* Update write address to start after the new sector header */
-    fcb->write_addr = next_sector * FLASH_SECTOR_SIZE + sizeof(SectorHeader);
+    used += frame;
+    exp->addr += fcb_item_size(fcb, key.len);
+    exp->record++;
   }
 
-  /* Prepare the item key */
-  struct ItemKey key;
-  key.magic = FCB_ENTRY_MAGIC;
-  key.len = len;
-  key.crc = crc32_gen(data, len);
-  key.status = FCB_STATUS_VALID;
+  *len_out = used;
+
+  return 0;
+}
+
+/**
+ * @brief Report erase counts and write statistics.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param stats Destination for the statistics.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_get_stats(Fcb *fcb, FcbStats *stats)
+{
+  if (fcb == NULL || fcb->dev == NULL || stats == NULL)
+  {
+    return -1;
+  }
 
-  /* Write the item key and payload to flash */
-  flash_write(fcb->write_addr, &key, sizeof(struct ItemKey));
-  flash_write(fcb->write_addr + sizeof(struct ItemKey), data, len);
+  uint64_t sum;
+  fcb_wear_range(fcb, &stats->wear_min, &stats->wear_max, &sum);
+  stats->wear_avg =
+      (uint32_t)(sum / (fcb->last_sector - fcb->first_sector + 1));
 
-  /* Advance the write address */
-  fcb->write_addr += item_size;
+  stats->skipped = 0;
+  for (uint32_t i = fcb->first_sector; i <= fcb->last_sector; i++)
+  {
+    stats->skipped += (uint32_t)fcb_sector_is_skipped(fcb, i);
+  }
+
+  stats->erases = fcb->stat_erases;
+  stats->bytes_appended = fcb->stat_appended;
+  stats->bytes_programmed = fcb->stat_programmed;
+  stats->write_amp_x100 =
+      (fcb->stat_appended == 0)
+          ? 0
+          : (uint32_t)(fcb->stat_programmed * 100 / fcb->stat_appended);
 
   return 0;
 }
@@ -1,9 +1,41 @@
 #ifndef FCB_H
 #define FCB_H
 
+#include "flash_dev.h"
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * @brief When appended items held in the write-combining buffer reach flash.
+ *
+ * Items still in RAM are lost on power failure; the policy bounds that loss
+ * window. fcb_flush() programs everything buffered regardless of policy.
+ */
+typedef enum {
+  FCB_DURABLE_IMMEDIATE = 0, /**< Program every append right away (default) */
+  FCB_DURABLE_PAGE,          /**< Program only whole flash pages */
+  FCB_DURABLE_TIME,          /**< Program once data is wb_max_age ticks old */
+  FCB_DURABLE_SIZE           /**< Program once wb_threshold bytes are held */
+} FcbDurability;
+
+/**
+ * @brief What fcb_append() does when the next sector still holds items.
+ */
+typedef enum {
+  FCB_FULL_REJECT = 0, /**< Fail the append with -2 (default) */
+  FCB_FULL_OVERWRITE   /**< Drop the oldest sector and keep writing */
+} FcbFullPolicy;
+
+/**
+ * @brief Slot of the keyed record index, see Fcb.kv_index.
+ */
+typedef struct {
+  uint32_t addr; /**< Flash address of the latest record's ItemKey, 0 if the
+                    slot is free, 0xFFFFFFFF if the ID's records were
+                    erased */
+  uint16_t id;   /**< Record ID */
+} FcbKvSlot;
+
 /**
  * @brief FCB Logistics Structure
  *
@@ -11,21 +43,213 @@
  * Flash Circular Buffer.
  */
 typedef struct {
+  const FlashDev *dev;   /**< Flash backend holding this FCB instance */
   uint32_t first_sector; /**< First sector index used by this FCB instance */
   uint32_t last_sector;  /**< Last sector index used by this FCB instance */
-  uint32_t sector_size;  /**< Size of each sector in bytes */
+  uint32_t sector_size;  /**< Size of each sector in bytes, a multiple of
+                            dev->erase_size; sector n starts at device
+                            address n * sector_size */
+  uint32_t erase_ahead;  /**< Sectors to keep erased ahead of the write
+                            sector by fcb_idle() (0 erases on rollover) */
+  uint8_t *wb_buf;       /**< Optional RAM write-combining buffer */
+  uint32_t wb_size;      /**< Size of wb_buf in bytes (0 disables it) */
+  FcbDurability durability; /**< Flush policy of the write-combining buffer */
+  uint32_t wb_threshold; /**< Buffered bytes that trigger FCB_DURABLE_SIZE */
+  uint32_t wb_max_age;   /**< Ticks that trigger FCB_DURABLE_TIME */
+  uint32_t (*clock)(void); /**< Tick source for FCB_DURABLE_TIME */
+  FcbFullPolicy full_policy; /**< Behaviour when the buffer is full */
+  uint32_t *record_index; /**< Optional RAM copy of each sector's first record
+                             number (last_sector - first_sector + 1
+                             entries), spares fcb_seek() the header reads */
+  uint32_t wear_skip;    /**< Pass over garbage sectors erased more than this
+                            many times above the least worn sector (0
+                            always erases the next sector) */
+  uint32_t align;        /**< Program unit: items are padded to it and start
+                            on its boundaries; a power of two dividing
+                            dev->page_size, at most 64 (0 or 1 packs items
+                            back to back) */
+  uint8_t *lz_buf;       /**< Optional scratch for record compression
+                            (fcb_lz.h): records that shrink are stored
+                            compressed; NULL stores every record as is */
+  uint32_t lz_size;      /**< Size of lz_buf in bytes, bounds the stored
+                            size of a compressed record */
+  FcbKvSlot *kv_index;   /**< Optional RAM index of keyed records
+                            (fcb_put()), rebuilt by fcb_mount(); while set,
+                            the sector ahead of the write sector is
+                            collected instead of running the buffer full */
+  uint32_t kv_slots;     /**< Entries in kv_index, a power of two above the
+                            number of distinct record IDs */
+  uint8_t *cache_buf;    /**< Optional RAM cache of recently appended
+                            items, served instead of backend reads (not
+                            used on memory-mapped devices) */
+  uint32_t cache_size;   /**< Size of cache_buf in bytes (0 disables it);
+                            an item takes 20 bytes plus its payload */
+  uint32_t ckpt_sectors; /**< Sectors right after last_sector holding the
+                            checkpoints of fcb_checkpoint(): 0 disables
+                            them, 2 alternates so one sector always keeps
+                            a checkpoint while the other is erased */
+  uint32_t sector_shift; /**< log2(sector_size) when it is a power of two,
+                            so that addresses split into sector and offset
+                            with a shift and a mask; 0 uses division. Set
+                            by fcb_mount() and fcb_erase() */
   uint32_t current_sector_id; /**< Monotonic ID of the current active sector */
   uint32_t write_addr;        /**< Next address to write new data to */
   uint32_t read_addr;   /**< Address to start the next read operation from */
   uint32_t delete_addr; /**< Address of the next item to be marked as consumed
                            (deleted) */
+  uint32_t erased_ahead; /**< Sectors after the write sector known erased */
+  volatile int erase_status; /**< Background erase progress, updated from
+                                the backend completion callback */
+  uint32_t wb_addr;  /**< Flash address of wb_buf[0] */
+  uint32_t wb_len;   /**< Bytes held in wb_buf, always ending at write_addr */
+  uint32_t wb_since; /**< Tick at which the oldest buffered byte arrived */
+  uint32_t overwritten; /**< Unconsumed records dropped by FCB_FULL_OVERWRITE
+                           since mount (wraps around) */
+  uint32_t next_record; /**< Record number the next appended item gets */
+  uint32_t erase_target;       /**< Sector of the background erase */
+  uint32_t erase_target_count; /**< Erase count carried over by it */
+  uint32_t cache_head;   /**< Offset of the oldest cached item in
+                            cache_buf */
+  uint32_t cache_used;   /**< Bytes of cache_buf in use */
+  uint32_t cache_count;  /**< Items held in cache_buf */
+  uint32_t cache_end;    /**< Flash address after the newest cached item */
+  uint32_t ckpt_addr;    /**< Flash address of the next free checkpoint
+                            slot */
+  uint32_t ckpt_counter; /**< Number of the latest checkpoint written */
+  uint32_t stat_erases;      /**< Sector erases since mount */
+  uint64_t stat_appended;    /**< Payload bytes appended since mount */
+  uint64_t stat_programmed;  /**< Bytes programmed to flash since mount */
 } Fcb;
 
+/**
+ * @brief Define an FCB instance whose geometry is checked at compile time.
+ *
+ * The sector size must be a power of two and the program unit a power of
+ * two up to 64 (0 or 1 packs items back to back), so the instance always
+ * takes the shift and mask path of Fcb.sector_shift. Fields left out get
+ * their defaults and can be set before fcb_mount(). Instances set up at run
+ * time with any sector size keep working as before.
+ *
+ * Example: static FCB_DEFINE(log_fcb, &flash_mem_dev, 0, 15, 4096, 0);
+ *
+ * @param name Name of the Fcb variable.
+ * @param device Pointer to the FlashDev holding the instance.
+ * @param first First sector index.
+ * @param last Last sector index.
+ * @param size Size of each sector in bytes.
+ * @param unit Program unit, see Fcb.align.
+ */
+#define FCB_DEFINE(name, device, first, last, size, unit)                     \
+  Fcb name = {.dev = (device),                                                \
+              .first_sector = (first),                                        \
+              .last_sector = (last),                                          \
+              .sector_size = (size),                                          \
+              .align = (unit)};                                               \
+  _Static_assert((size) > 0 && ((size) & ((size) - 1)) == 0,                  \
+                 #name ": sector size must be a power of two");               \
+  _Static_assert((first) <= (last), #name ": empty sector range");            \
+  _Static_assert((unit) <= 64 && ((unit) & ((unit) - 1)) == 0,                \
+                 #name ": program unit must be a power of two up to 64")
+
+/**
+ * @brief Wear and write statistics reported by fcb_get_stats().
+ */
+typedef struct {
+  uint32_t erases;           /**< Sector erases since mount */
+  uint64_t bytes_appended;   /**< Payload bytes appended since mount */
+  uint64_t bytes_programmed; /**< Bytes programmed since mount, including
+                                headers and status updates */
+  uint32_t write_amp_x100;   /**< bytes_programmed / bytes_appended x 100 */
+  uint32_t wear_min;         /**< Lowest sector erase count */
+  uint32_t wear_max;         /**< Highest sector erase count */
+  uint32_t wear_avg;         /**< Average sector erase count, rounded down */
+  uint32_t skipped;          /**< Sectors currently passed over for wear */
+} FcbStats;
+
+/**
+ * @brief One item of a batched append, or one segment of a record given to
+ * fcb_appendv(), modelled after POSIX struct iovec.
+ */
+typedef struct {
+  const void *iov_base; /**< Pointer to the item payload */
+  uint16_t iov_len;     /**< Payload length in bytes */
+} FcbIovec;
+
+/**
+ * @brief FcbItem.flags: the payload is a compressed record.
+ *
+ * It holds the record length (16 bits, little endian) followed by an LZ4
+ * block, see fcb_lz_decompress(). fcb_read() decompresses transparently.
+ */
+#define FCB_ITEM_COMPRESSED 0x1
+
+/**
+ * @brief FcbItem.flags: the payload is a keyed record, see fcb_put().
+ *
+ * It holds the record ID (16 bits, little endian) followed by the value.
+ */
+#define FCB_ITEM_KEYED 0x2
+
+/**
+ * @brief Location of a stored item, as handed out by the reader API.
+ *
+ * The payload is described by its absolute flash address so that callers
+ * can transmit straight from flash without copying it through RAM. On
+ * memory-mapped devices it can also be used in place through data.
+ */
+typedef struct {
+  uint32_t addr; /**< Absolute flash address of the item payload */
+  uint16_t len;  /**< Payload length in bytes */
+  uint32_t crc;  /**< CRC32 of the payload as stored in the ItemKey */
+  uint16_t flags; /**< FCB_ITEM_COMPRESSED and FCB_ITEM_KEYED bits */
+  const uint8_t *data; /**< The payload in the mapped device view, NULL if
+                          the device has none (see FlashDev.base) */
+} FcbItem;
+
+/**
+ * @brief Callback invoked by fcb_walk() for every unread item.
+ *
+ * @param item Location of the item payload in flash.
+ * @param arg User argument passed to fcb_walk().
+ * @return int 0 to continue walking, any other value stops the walk and is
+ * returned by fcb_walk().
+ */
+typedef int (*fcb_walk_cb)(const FcbItem *item, void *arg);
+
+/**
+ * @brief Size of the frame header fcb_export() puts before every payload.
+ *
+ * All fields are little endian:
+ *
+ *   offset 0  uint16_t len     stored payload length
+ *   offset 2  uint16_t flags   FCB_ITEM_COMPRESSED and FCB_ITEM_KEYED bits
+ *   offset 4  uint32_t record  record number
+ *   offset 8  uint32_t crc     CRC32 of the payload, as stored in flash
+ *   offset 12 len bytes        payload, as stored in flash
+ */
+#define FCB_EXPORT_HDR_SIZE 12
+
+/**
+ * @brief Position of an export stream, see fcb_export().
+ *
+ * record is the resume cookie: the number of the first record that has not
+ * been exported yet. Passing the number after the last record the receiver
+ * accepted to fcb_export_resume() restarts the stream after a disconnect.
+ */
+typedef struct {
+  uint32_t addr;   /**< Flash address the walk continues from */
+  uint32_t record; /**< Record number of the item at addr */
+} FcbExport;
+
 /**
  * @brief Initialize the FCB by scanning the flash sectors.
  *
+ * Several instances may share one device as long as their sector ranges do
+ * not overlap.
+ *
  * @param fcb Pointer to the FCB logistics structure.
- * @return int 0 on success, non-zero error code otherwise.
+ * @return int 0 on success, -1 if the geometry does not fit the device,
+ * non-zero error code otherwise.
  */
 int fcb_mount(Fcb *fcb);
 
@@ -35,10 +259,129 @@ int fcb_mount(Fcb *fcb);
  * @param fcb Pointer to the FCB logistics structure.
  * @param data Pointer to the data to be written.
  * @param len Length of the data in bytes.
- * @return int 0 on success, non-zero error code otherwise.
+ * @return int 0 on success, non-zero error code otherwise (-2 when the
+ * buffer is full and Fcb.full_policy is FCB_FULL_REJECT, -4 while the next
+ * sector is still being erased in the background).
  */
 int fcb_append(Fcb *fcb, const void *data, uint16_t len);
 
+/**
+ * @brief Append one item gathered from several buffers.
+ *
+ * The segments are stored back to back as a single record, the CRC is
+ * computed across them as they are written, so the record never has to be
+ * assembled in RAM. The record is stored uncompressed.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param iov Array of segments, empty ones are allowed.
+ * @param cnt Number of entries in the array.
+ * @return int 0 on success, -1 on invalid arguments (including a record
+ * that is empty or longer than 65535 bytes), otherwise as fcb_append().
+ */
+int fcb_appendv(Fcb *fcb, const FcbIovec *iov, size_t cnt);
+
+/**
+ * @brief Append several items to the FCB in a single programming pass.
+ *
+ * Sector placement is planned once for the whole batch and the item keys and
+ * payloads are packed into a staging buffer of one device page (at most
+ * FCB_STAGE_SIZE bytes, 256 by default, as it lives on the stack), so
+ * consecutive small items share program operations. Appending stops at the
+ * first item that is empty or does not fit, and at the first flash error:
+ * only items programmed completely before it count, the ones the failed
+ * program touched are skipped by the readers and the ones it did not reach
+ * are not appended. With the write-combining buffer, items count once they
+ * are buffered and an error fails the item that ran into it, as with
+ * fcb_append().
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param iov Array of items to append.
+ * @param cnt Number of entries in the array.
+ * @return int Number of items committed, -1 on invalid arguments, -3 if a
+ * flash error stopped the batch before any item was committed.
+ */
+int fcb_append_batch(Fcb *fcb, const FcbIovec *iov, size_t cnt);
+
+/**
+ * @brief Append a keyed record, superseding earlier ones with the same ID.
+ *
+ * Needs Fcb.kv_index. The record is stored uncompressed with its ID in
+ * front of the value and becomes what fcb_get_latest() returns for the ID.
+ * Before the write sector moves next to the oldest sector, that sector is
+ * collected: the latest record of every ID still in it is copied forward,
+ * superseded records are dropped without copying, and plain records left
+ * unconsumed are dropped and counted in Fcb.overwritten. The copies are
+ * appended records and show up to fcb_read() again.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param id Record ID.
+ * @param data Pointer to the value, may be NULL if len is 0.
+ * @param len Length of the value in bytes, at most 65533.
+ * @return int 0 on success, -1 on invalid arguments or if keyed mode is
+ * off, -2 if the index has no room for a new ID or the buffer is full,
+ * otherwise as fcb_append().
+ */
+int fcb_put(Fcb *fcb, uint16_t id, const void *data, uint16_t len);
+
+/**
+ * @brief Read the latest value stored for a record ID.
+ *
+ * One index lookup and one item read, without scanning.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param id Record ID.
+ * @param buf Buffer to store the value, may be NULL if buf_len is 0.
+ * @param buf_len Size of the buffer in bytes.
+ * @param len_out Pointer to store the length of the value, may be NULL.
+ * @return int 0 on success, -1 on invalid arguments or if keyed mode is
+ * off, -2 if the ID has no live record, -3 if the buffer is too small
+ * (len_out still receives the length), -4 if the CRC check fails.
+ */
+int fcb_get_latest(Fcb *fcb, uint16_t id, void *buf, uint16_t buf_len,
+                   uint16_t *len_out);
+
+/**
+ * @brief Program everything held in the write-combining buffer.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, -1 on invalid arguments, -3 on flash error.
+ */
+int fcb_flush(Fcb *fcb);
+
+/**
+ * @brief Record the buffer positions so the next mount can skip its scans.
+ *
+ * Needs Fcb.ckpt_sectors. Flushes the write-combining buffer, then appends
+ * a CRC protected checkpoint of the sector sequence, the write, read and
+ * delete positions and the next record number to the checkpoint sectors.
+ * fcb_mount() takes the positions from the newest checkpoint as long as
+ * nothing was appended and no sector was reserved since; otherwise, or if
+ * the checkpoint is damaged, it scans as usual. Call it on clean shutdown
+ * or periodically; the read position recorded is restored by the mount.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, -1 on invalid arguments or if checkpoints are
+ * off, -3 on flash error.
+ */
+int fcb_checkpoint(Fcb *fcb);
+
+/**
+ * @brief Idle hook: prepare sectors ahead of the write position.
+ *
+ * Erases the next sector after the ones already known to be erased, up to
+ * Fcb.erase_ahead sectors ahead of the write sector, so that a later sector
+ * rollover in fcb_append() only has to write the sector header. Uses the
+ * backend's asynchronous erase when available; the sector being erased is
+ * accounted for on a later call once the erase has completed. Sectors that
+ * still hold unconsumed items are never erased. Also enforces the
+ * FCB_DURABLE_TIME policy of the write-combining buffer.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 1 if an erase was started or is still in progress, 0 if there
+ * is nothing to do, -1 on invalid arguments, -3 on flash error.
+ */
+int fcb_idle(Fcb *fcb);
+
 /**
  * @brief Erase all sectors associated with the FCB and reset its state.
  *
@@ -47,4 +390,195 @@ int fcb_append(Fcb *fcb, const void *data, uint16_t len);
  */
 int fcb_erase(Fcb *fcb);
 
+/**
+ * @brief Locate the item at the read position without consuming it.
+ *
+ * An item still held in the write-combining buffer is flushed first so that
+ * the returned location is valid.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item Pointer to store the item location.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no unread item.
+ */
+int fcb_peek(Fcb *fcb, FcbItem *item);
+
+/**
+ * @brief Hand out the item at the read position and advance past it.
+ *
+ * Zero-copy variant of fcb_read(): the payload is not read or verified,
+ * only its flash location is returned. An item still held in the
+ * write-combining buffer is flushed first so that the location is valid.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param item Pointer to store the item location.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no unread item.
+ */
+int fcb_next(Fcb *fcb, FcbItem *item);
+
+/**
+ * @brief Copy the item at the read position into a buffer and advance past
+ * it.
+ *
+ * Compressed records are decompressed into the buffer; on devices without
+ * a mapped view that needs an lz_buf large enough for the stored payload.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param buf Destination buffer.
+ * @param buf_len Size of the destination buffer in bytes.
+ * @param len_out Optional pointer to store the record length.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no unread item,
+ * -3 if the buffer or lz_buf is too small (the read position is not
+ * advanced), -4 if the payload failed its CRC check or does not decompress
+ * (the item is skipped).
+ */
+int fcb_read(Fcb *fcb, void *buf, uint16_t buf_len, uint16_t *len_out);
+
+/**
+ * @brief Mark the oldest item as consumed.
+ *
+ * Clears the item status to popped and retires sectors that no longer hold
+ * any live item.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @return int 0 on success, -1 on invalid arguments, -2 if no item to pop.
+ */
+int fcb_pop(Fcb *fcb);
+
+/**
+ * @brief Move the read position to a given record.
+ *
+ * Every appended item gets the next number of a monotonic record counter
+ * (Fcb.next_record). The sector holding the record is found by a binary
+ * search over the first record numbers of the live sectors, then only that
+ * sector is walked.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record Record number to read next.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the record has
+ * already been consumed, was lost or has not been written yet.
+ */
+int fcb_seek(Fcb *fcb, uint32_t record);
+
+/**
+ * @brief Record number of the item the next read returns.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record Pointer to store the record number; when there is no unread
+ * item this is the number the next appended item gets.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_tell(Fcb *fcb, uint32_t *record);
+
+/**
+ * @brief Consume every item that starts before a flash address.
+ *
+ * Bulk variant of fcb_pop(). Sectors that are left entirely behind are
+ * retired with one header write instead of one status write per item; only
+ * the items of the sector holding addr are marked individually. Passing an
+ * FcbItem.addr consumes that item too, passing Fcb.write_addr consumes
+ * everything.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param addr Absolute flash address.
+ * @return int 0 on success, -1 on invalid arguments, -2 if addr is outside
+ * the unconsumed part of the buffer.
+ */
+int fcb_consume_until(Fcb *fcb, uint32_t addr);
+
+/**
+ * @brief Consume every record numbered before a given record.
+ *
+ * Same as fcb_consume_until() with the record located as in fcb_seek().
+ * Records that are already consumed are not an error.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param record First record number to keep (Fcb.next_record consumes
+ * everything).
+ * @return int 0 on success, -1 on invalid arguments, -2 if the record has
+ * not been written yet or was lost.
+ */
+int fcb_consume_until_record(Fcb *fcb, uint32_t record);
+
+/**
+ * @brief Walk all unread items without consuming them.
+ *
+ * Like fcb_next(), flushes the write-combining buffer before handing out an
+ * item that is still held in RAM.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param cb Callback invoked with the flash location of every item.
+ * @param arg User argument passed to the callback.
+ * @return int 0 when all items were visited, -1 on invalid arguments, or the
+ * non-zero value returned by the callback.
+ */
+int fcb_walk(Fcb *fcb, fcb_walk_cb cb, void *arg);
+
+/**
+ * @brief Start an export stream at the read position.
+ *
+ * Exporting does not read or consume anything: the read position is left
+ * alone, and the stream follows items appended while it runs.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param exp Export stream to initialise.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_export_begin(Fcb *fcb, FcbExport *exp);
+
+/**
+ * @brief Restart an export stream at a record.
+ *
+ * The record may lie before the read position, as long as it has not been
+ * consumed yet.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param exp Export stream to initialise.
+ * @param cookie Record number to export next, FcbExport.record of the
+ * interrupted stream or the record after the last one the receiver has.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the record has
+ * been consumed, was lost or has not been written yet (Fcb.next_record is
+ * accepted and exports what is appended from then on).
+ */
+int fcb_export_resume(Fcb *fcb, FcbExport *exp, uint32_t cookie);
+
+/**
+ * @brief Fill a buffer with the next frames of an export stream.
+ *
+ * Every intact item that is not popped becomes one frame of
+ * FCB_EXPORT_HDR_SIZE bytes followed by its payload, see
+ * FCB_EXPORT_HDR_SIZE. Padding, erased space and popped items are left
+ * out; payloads and CRCs are copied as stored, so the receiver checks each
+ * frame with one CRC32 over its payload. The buffer only ever holds whole
+ * frames and is filled straight from flash, so it can be handed to a
+ * socket or DMA engine as is.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param exp Export stream, advanced past the frames returned.
+ * @param buf Destination buffer.
+ * @param buf_len Size of the buffer in bytes, FCB_EXPORT_HDR_SIZE + 0xFFFF
+ * holds any frame.
+ * @param len_out Pointer to store the number of bytes filled, 0 once the
+ * stream has caught up with the write position.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the items at the
+ * stream position have been consumed since (fcb_export_resume() with
+ * FcbExport.record tells whether any of them is left), -3 if the next
+ * frame does not fit into the buffer or on flash read error (len_out then
+ * covers the frames before it).
+ */
+int fcb_export(Fcb *fcb, FcbExport *exp, void *buf, uint32_t buf_len,
+               uint32_t *len_out);
+
+/**
+ * @brief Report erase counts and write statistics.
+ *
+ * Every sector header carries an erase counter that survives erases, so the
+ * wear figures cover the whole life of the partition while the byte and
+ * erase totals restart at fcb_mount(). Reads every sector header.
+ *
+ * @param fcb Pointer to the FCB logistics structure.
+ * @param stats Destination for the statistics.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_get_stats(Fcb *fcb, FcbStats *stats);
+
 #endif // FCB_H
@@ -0,0 +1,265 @@
+/**
+ * @file fcb_lz.c
+ * @brief LZ4 block codec for compressed FCB records
+ *
+ * A block is a series of sequences. Each one starts with a token whose high
+ * nibble is the literal count and low nibble the match length minus 4; a
+ * nibble of 15 is continued by bytes of 255 and a final byte below 255. The
+ * literals follow, then a 16-bit little endian match offset and the match
+ * length continuation. The last sequence only has literals. As required by
+ * the format, the last 5 bytes are always literals and no match starts in
+ * the last 12 bytes.
+ */
+
+#include "fcb_lz.h"
+#include <string.h>
+
+#define FCB_LZ_MIN_MATCH 4     /**< Shortest match the format can encode */
+#define FCB_LZ_LAST_LITERALS 5 /**< Bytes at the end that stay literals */
+#define FCB_LZ_MF_LIMIT 12     /**< No match may start this close to the end */
+
+/*============================================================================
+ * Private Functions
+ *============================================================================*/
+
+static uint32_t fcb_lz_read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+
+  return v;
+}
+
+static uint32_t fcb_lz_hash(uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - FCB_LZ_HASH_BITS);
+}
+
+/**
+ * @brief Write a length continuation (the part above a nibble of 15).
+ *
+ * @param dst Output buffer.
+ * @param op Write position, advanced past the bytes written.
+ * @param n Length minus 15.
+ */
+static void fcb_lz_put_length(uint8_t *dst, uint32_t *op, uint32_t n)
+{
+  while (n >= 255)
+  {
+    dst[(*op)++] = 255;
+    n -= 255;
+  }
+
+  dst[(*op)++] = (uint8_t)n;
+}
+
+/**
+ * @brief Emit one sequence.
+ *
+ * @param dst Output buffer.
+ * @param cap Size of dst.
+ * @param op Write position, advanced past the sequence.
+ * @param lit Literals of the sequence.
+ * @param lit_len Number of literals.
+ * @param offset Match offset, ignored for the last sequence.
+ * @param match_len Match length, 0 for the last sequence.
+ * @return int 0 on success, -1 if the sequence does not fit.
+ */
+static int fcb_lz_emit(uint8_t *dst, uint32_t cap, uint32_t *op,
+                       const uint8_t *lit, uint32_t lit_len, uint32_t offset,
+                       uint32_t match_len)
+{
+  uint32_t ml = (match_len > 0) ? match_len - FCB_LZ_MIN_MATCH : 0;
+  uint32_t need = 1 + lit_len + (lit_len >= 15 ? (lit_len - 15) / 255 + 1 : 0);
+  if (match_len > 0)
+  {
+    need += 2 + (ml >= 15 ? (ml - 15) / 255 + 1 : 0);
+  }
+
+  if (need > cap - *op)
+  {
+    return -1;
+  }
+
+  uint8_t *token = &dst[(*op)++];
+  *token = (uint8_t)(((lit_len < 15) ? lit_len : 15) << 4);
+  if (lit_len >= 15)
+  {
+    fcb_lz_put_length(dst, op, lit_len - 15);
+  }
+
+  memcpy(&dst[*op], lit, lit_len);
+  *op += lit_len;
+
+  if (match_len > 0)
+  {
+    *token |= (uint8_t)((ml < 15) ? ml : 15);
+    dst[(*op)++] = (uint8_t)(offset & 0xFF);
+    dst[(*op)++] = (uint8_t)(offset >> 8);
+    if (ml >= 15)
+    {
+      fcb_lz_put_length(dst, op, ml - 15);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Read a length continuation.
+ *
+ * @param src Input block.
+ * @param len Length of the block.
+ * @param ip Read position, advanced past the bytes read.
+ * @param n Length so far, incremented by the continuation.
+ * @return int 0 on success, -1 if the block ends inside it.
+ */
+static int fcb_lz_get_length(const uint8_t *src, uint32_t len, uint32_t *ip,
+                             uint32_t *n)
+{
+  uint8_t b;
+
+  do
+  {
+    if (*ip >= len)
+    {
+      return -1;
+    }
+
+    b = src[(*ip)++];
+    *n += b;
+  } while (b == 255);
+
+  return 0;
+}
+
+/*============================================================================
+ * Public Functions
+ *============================================================================*/
+
+uint32_t fcb_lz_compress(const uint8_t *src, uint32_t len, uint8_t *dst,
+                         uint32_t cap)
+{
+  if (src == NULL || dst == NULL || len > 0xFFFF)
+  {
+    return 0;
+  }
+
+  uint32_t op = 0;
+  uint32_t anchor = 0;
+
+  if (len > FCB_LZ_MF_LIMIT)
+  {
+    /* Positions fit in 16 bits as records are at most 65535 bytes */
+    uint16_t table[1u << FCB_LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    uint32_t limit = len - FCB_LZ_MF_LIMIT;
+    uint32_t ip = 0;
+
+    while (ip < limit)
+    {
+      uint32_t v = fcb_lz_read32(&src[ip]);
+      uint32_t h = fcb_lz_hash(v);
+      uint32_t ref = table[h];
+      table[h] = (uint16_t)ip;
+
+      if (ref >= ip || fcb_lz_read32(&src[ref]) != v)
+      {
+        ip++;
+        continue;
+      }
+
+      /* Extend the match, leaving the last literals alone */
+      uint32_t max = len - FCB_LZ_LAST_LITERALS - ip;
+      uint32_t match_len = FCB_LZ_MIN_MATCH;
+      while (match_len < max && src[ref + match_len] == src[ip + match_len])
+      {
+        match_len++;
+      }
+
+      if (fcb_lz_emit(dst, cap, &op, &src[anchor], ip - anchor, ip - ref,
+                      match_len) != 0)
+      {
+        return 0;
+      }
+
+      ip += match_len;
+      anchor = ip;
+    }
+  }
+
+  if (fcb_lz_emit(dst, cap, &op, &src[anchor], len - anchor, 0, 0) != 0)
+  {
+    return 0;
+  }
+
+  return op;
+}
+
+int fcb_lz_decompress(const uint8_t *src, uint32_t len, uint8_t *dst,
+                      uint32_t cap)
+{
+  if (src == NULL || dst == NULL)
+  {
+    return -1;
+  }
+
+  uint32_t ip = 0;
+  uint32_t op = 0;
+
+  while (ip < len)
+  {
+    uint8_t token = src[ip++];
+
+    uint32_t lit_len = token >> 4;
+    if (lit_len == 15 && fcb_lz_get_length(src, len, &ip, &lit_len) != 0)
+    {
+      return -1;
+    }
+
+    if (lit_len > len - ip || lit_len > cap - op)
+    {
+      return -1;
+    }
+
+    memcpy(&dst[op], &src[ip], lit_len);
+    ip += lit_len;
+    op += lit_len;
+
+    /* The last sequence ends with its literals */
+    if (ip == len)
+    {
+      break;
+    }
+
+    if (len - ip < 2)
+    {
+      return -1;
+    }
+
+    uint32_t offset = (uint32_t)src[ip] | ((uint32_t)src[ip + 1] << 8);
+    ip += 2;
+
+    uint32_t match_len = token & 15;
+    if (match_len == 15 && fcb_lz_get_length(src, len, &ip, &match_len) != 0)
+    {
+      return -1;
+    }
+    match_len += FCB_LZ_MIN_MATCH;
+
+    if (offset == 0 || offset > op || match_len > cap - op)
+    {
+      return -1;
+    }
+
+    /* Byte by byte, the match may overlap the bytes it produces */
+    for (uint32_t i = 0; i < match_len; i++)
+    {
+      dst[op + i] = dst[op - offset + i];
+    }
+    op += match_len;
+  }
+
+  return (int)op;
+}
@@ -0,0 +1,49 @@
+#ifndef FCB_LZ_H
+#define FCB_LZ_H
+
+#include <stdint.h>
+
+/**
+ * @brief log2 of the compressor hash table size.
+ *
+ * The table lives on the stack of fcb_lz_compress() and takes
+ * 2 << FCB_LZ_HASH_BITS bytes; more bits find more matches.
+ */
+#ifndef FCB_LZ_HASH_BITS
+#define FCB_LZ_HASH_BITS 9
+#endif
+
+/**
+ * @brief Compress a buffer into an LZ4 block.
+ *
+ * The output is a raw LZ4 block (no frame, no length), so host tools can
+ * decode it with LZ4_decompress_safe(). Matches are found greedily through
+ * a small hash table, which keeps the compressor fast and its stack use
+ * bounded at the cost of some ratio.
+ *
+ * @param src Data to compress, at most 65535 bytes.
+ * @param len Length of src in bytes.
+ * @param dst Output buffer.
+ * @param cap Size of dst in bytes.
+ * @return uint32_t Length of the block, or 0 if it does not fit in cap.
+ */
+uint32_t fcb_lz_compress(const uint8_t *src, uint32_t len, uint8_t *dst,
+                         uint32_t cap);
+
+/**
+ * @brief Decode an LZ4 block.
+ *
+ * Every length and match offset is checked, so corrupted input can neither
+ * read nor write outside the buffers.
+ *
+ * @param src LZ4 block.
+ * @param len Length of src in bytes.
+ * @param dst Output buffer.
+ * @param cap Size of dst in bytes.
+ * @return int Number of bytes decoded, or -1 if the block is malformed or
+ * does not fit in cap.
+ */
+int fcb_lz_decompress(const uint8_t *src, uint32_t len, uint8_t *dst,
+                      uint32_t cap);
+
+#endif // FCB_LZ_H
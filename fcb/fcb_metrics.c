@@ -0,0 +1,36 @@
+/**
+ * @file fcb_metrics.c
+ * @brief Storage and histogram update of the FCB instrumentation
+ *
+ * Only built into the library when FCB_METRICS is enabled.
+ */
+
+#include "fcb_metrics.h"
+#include <string.h>
+
+FCB_METRICS_STORAGE FcbMetrics fcb_metrics;
+
+void fcb_metrics_reset(void)
+{
+  memset(&fcb_metrics, 0, sizeof(fcb_metrics));
+}
+
+void fcb_metrics_record(FcbMetric metric, uint32_t cycles)
+{
+  FcbHistogram *hist = &fcb_metrics.hist[metric];
+
+  /* Bucket index is the bit length of the sample */
+  uint32_t bucket = (cycles == 0) ? 0 : 32 - (uint32_t)__builtin_clz(cycles);
+  if (bucket >= FCB_METRICS_BUCKETS)
+  {
+    bucket = FCB_METRICS_BUCKETS - 1;
+  }
+
+  hist->buckets[bucket]++;
+  hist->count++;
+  hist->total += cycles;
+  if (cycles > hist->max)
+  {
+    hist->max = cycles;
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef FCB_METRICS_H
+#define FCB_METRICS_H
+
+#include <stdint.h>
+
+/**
+ * @file fcb_metrics.h
+ * @brief Optional hot-path instrumentation of the Flash Circular Buffer
+ *
+ * Built with FCB_METRICS defined to 1 (the FCB_METRICS CMake option), the
+ * library times CRC calculations, flash programming, erases and the mount
+ * scans into log2 cycle histograms and keeps a few traffic counters in the
+ * global fcb_metrics. Without it every hook expands to nothing.
+ */
+
+/**
+ * @brief Number of histogram buckets.
+ *
+ * Bucket 0 counts samples of 0 cycles, bucket b counts samples in
+ * [2^(b-1), 2^b) cycles; the last bucket also takes everything above.
+ */
+#define FCB_METRICS_BUCKETS 32
+
+/**
+ * @brief Instrumented operations.
+ */
+typedef enum {
+  FCB_METRIC_CRC = 0,      /**< One CRC32 calculation */
+  FCB_METRIC_FLASH_WRITE,  /**< One page program call of the backend */
+  FCB_METRIC_ERASE,        /**< One synchronous sector erase */
+  FCB_METRIC_HEADER_SCAN,  /**< Head/tail sector search of fcb_mount() */
+  FCB_METRIC_ITEM_SCAN,    /**< Head or tail item search of fcb_mount() */
+  FCB_METRIC_COUNT         /**< Number of instrumented operations */
+} FcbMetric;
+
+/**
+ * @brief Latency histogram of one operation, in cycles.
+ */
+typedef struct {
+  uint32_t count; /**< Number of samples */
+  uint32_t max;   /**< Slowest sample */
+  uint64_t total; /**< Sum of all samples */
+  uint32_t buckets[FCB_METRICS_BUCKETS]; /**< log2 latency buckets */
+} FcbHistogram;
+
+/**
+ * @brief Collected instrumentation data.
+ */
+typedef struct {
+  FcbHistogram hist[FCB_METRIC_COUNT]; /**< Indexed by FcbMetric */
+  uint64_t bytes_programmed; /**< Bytes handed to the program operation */
+  uint32_t reads;            /**< Read calls issued to the backend */
+  uint32_t mount_reads;      /**< Read calls issued by the last fcb_mount() */
+  uint64_t recovery_skipped; /**< Bytes stepped over while resynchronising
+                                a scan past erased or corrupted data */
+  uint32_t cache_hits;   /**< Reads served from Fcb.cache_buf */
+  uint32_t cache_misses; /**< Reads of a cached FCB passed to the backend */
+} FcbMetrics;
+
+/**
+ * @brief Storage class of fcb_metrics.
+ *
+ * Empty by default. Host builds define it to _Thread_local so that FCBs
+ * driven from different threads, as by fcb_mount_many(), each count into
+ * their own thread's copy instead of racing on a shared one.
+ */
+#ifndef FCB_METRICS_STORAGE
+#define FCB_METRICS_STORAGE
+#endif
+
+#if FCB_METRICS
+
+/**
+ * @brief Cycle counter used for the latency samples.
+ *
+ * Defaults to the time stamp counter on x86 and the virtual counter on
+ * AArch64. Other targets provide fcb_metrics_cycles(), or define
+ * FCB_METRICS_NOW() to an expression reading their cycle counter (for
+ * example DWT->CYCCNT on Cortex-M).
+ */
+#ifndef FCB_METRICS_NOW
+#if defined(__x86_64__) || defined(__i386__)
+#define FCB_METRICS_NOW() ((uint32_t)__builtin_ia32_rdtsc())
+#elif defined(__aarch64__)
+static inline uint32_t fcb_metrics_cntvct(void)
+{
+  uint64_t v;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return (uint32_t)v;
+}
+#define FCB_METRICS_NOW() fcb_metrics_cntvct()
+#else
+#define FCB_METRICS_NOW() fcb_metrics_cycles()
+#endif
+#endif
+
+/**
+ * @brief Instrumentation data of all FCB instances.
+ *
+ * Updated without locking; read it from the task that drives the FCBs.
+ */
+extern FCB_METRICS_STORAGE FcbMetrics fcb_metrics;
+
+/**
+ * @brief Clear all histograms and counters.
+ */
+void fcb_metrics_reset(void);
+
+/**
+ * @brief Add a latency sample to a histogram.
+ *
+ * @param metric The instrumented operation.
+ * @param cycles Duration of the operation in cycles.
+ */
+void fcb_metrics_record(FcbMetric metric, uint32_t cycles);
+
+/**
+ * @brief Board supplied cycle counter, used when no default exists.
+ *
+ * @return uint32_t Free running cycle count.
+ */
+uint32_t fcb_metrics_cycles(void);
+
+#define FCB_METRIC_BEGIN(name) uint32_t name##_t0 = FCB_METRICS_NOW()
+#define FCB_METRIC_END(metric, name)                                          \
+  fcb_metrics_record((metric), FCB_METRICS_NOW() - name##_t0)
+#define FCB_METRIC_ADD(field, n) (fcb_metrics.field += (n))
+#define FCB_METRIC_READS_BEGIN(name) uint32_t name##_reads = fcb_metrics.reads
+#define FCB_METRIC_READS_END(field, name)                                     \
+  (fcb_metrics.field = fcb_metrics.reads - name##_reads)
+
+#else
+
+#define FCB_METRIC_BEGIN(name) ((void)0)
+#define FCB_METRIC_END(metric, name) ((void)0)
+#define FCB_METRIC_ADD(field, n) ((void)(n))
+#define FCB_METRIC_READS_BEGIN(name) ((void)0)
+#define FCB_METRIC_READS_END(field, name) ((void)0)
+
+#endif // FCB_METRICS
+
+#endif // FCB_METRICS_H
@@ -0,0 +1,142 @@
+/**
+ * @file fcb_mount_many.c
+ * @brief Worker pool mounting FCB partitions in parallel
+ *
+ * The workers share a single atomic cursor into the partition list and
+ * nothing else: every partition is mounted by exactly one worker, which
+ * also stores its result. pthread_join() makes those stores visible to the
+ * caller.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* sysconf(_SC_NPROCESSORS_ONLN) */
+
+#include "fcb_mount_many.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/**
+ * @brief State shared by the workers of one fcb_mount_many() call.
+ */
+typedef struct {
+  Fcb *const *fcbs;     /**< Partitions to mount */
+  int *rcs;             /**< Per partition results, or NULL */
+  size_t count;         /**< Number of partitions */
+  _Atomic size_t next;  /**< Next partition to hand out */
+  _Atomic int failed;   /**< Partitions that failed to mount */
+} FcbMountJob;
+
+/*============================================================================
+ * Private Functions
+ *============================================================================*/
+
+/**
+ * @brief Mount partitions until none are left.
+ *
+ * @param job Shared job state.
+ */
+static void fcb_mount_many_run(FcbMountJob *job)
+{
+  for (;;)
+  {
+    size_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+    if (i >= job->count)
+    {
+      break;
+    }
+
+    int rc = fcb_mount(job->fcbs[i]);
+    if (job->rcs != NULL)
+    {
+      job->rcs[i] = rc;
+    }
+
+    if (rc != 0)
+    {
+      atomic_fetch_add_explicit(&job->failed, 1, memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * @brief pthread entry point of a worker.
+ *
+ * @param arg The FcbMountJob.
+ * @return void* Always NULL.
+ */
+static void *fcb_mount_many_worker(void *arg)
+{
+  fcb_mount_many_run((FcbMountJob *)arg);
+
+  return NULL;
+}
+
+/*============================================================================
+ * Public Functions
+ *============================================================================*/
+
+/**
+ * @brief Mount several FCB partitions concurrently on a worker pool.
+ *
+ * @param fcbs Partitions to mount, each configured as for fcb_mount().
+ * @param count Number of partitions.
+ * @param rcs Optional array of count entries receiving the fcb_mount()
+ * result of each partition.
+ * @param workers Maximum number of threads, 0 for one per online CPU.
+ * @return int Number of partitions that failed to mount, or -1 on invalid
+ * arguments.
+ */
+int fcb_mount_many(Fcb *const *fcbs, size_t count, int *rcs,
+                   unsigned workers)
+{
+  if (fcbs == NULL && count > 0)
+  {
+    return -1;
+  }
+
+  if (workers == 0)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = (cpus > 0) ? (unsigned)cpus : 1;
+  }
+
+  if (workers > FCB_MOUNT_MANY_MAX_WORKERS)
+  {
+    workers = FCB_MOUNT_MANY_MAX_WORKERS;
+  }
+
+  if (workers > count)
+  {
+    workers = (unsigned)count;
+  }
+
+  FcbMountJob job;
+  job.fcbs = fcbs;
+  job.rcs = rcs;
+  job.count = count;
+  atomic_init(&job.next, 0);
+  atomic_init(&job.failed, 0);
+
+  /* The caller is the first worker, start the others */
+  pthread_t threads[FCB_MOUNT_MANY_MAX_WORKERS];
+  unsigned started = 0;
+  while (started + 1 < workers)
+  {
+    if (pthread_create(&threads[started], NULL, fcb_mount_many_worker,
+                       &job) != 0)
+    {
+      break;
+    }
+
+    started++;
+  }
+
+  fcb_mount_many_run(&job);
+
+  for (unsigned i = 0; i < started; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  return atomic_load_explicit(&job.failed, memory_order_relaxed);
+}
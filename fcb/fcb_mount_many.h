@@ -0,0 +1,46 @@
+#ifndef FCB_MOUNT_MANY_H
+#define FCB_MOUNT_MANY_H
+
+#include "fcb.h"
+#include <stddef.h>
+
+/**
+ * @file fcb_mount_many.h
+ * @brief Concurrent mount of many FCB partitions on POSIX hosts
+ *
+ * fcb_mount() only touches its own Fcb and the backend it points at, and
+ * the library keeps no mutable globals (the CRC tables are constant data,
+ * the optional metrics are per thread on hosts). Partitions can therefore
+ * be mounted in parallel, as long as no two of them share a backend that is
+ * not thread-safe itself: flash_file images are independent of each other,
+ * while partitions of the single flash_mem_dev must not be mixed with
+ * partitions that erase or program it concurrently.
+ */
+
+/**
+ * @brief Upper bound on the threads fcb_mount_many() runs.
+ */
+#ifndef FCB_MOUNT_MANY_MAX_WORKERS
+#define FCB_MOUNT_MANY_MAX_WORKERS 64
+#endif
+
+/**
+ * @brief Mount several FCB partitions concurrently on a worker pool.
+ *
+ * Partitions are handed to the workers one at a time, so a few slow images
+ * do not hold up the rest. The calling thread works as well; if a worker
+ * thread cannot be started, the remaining ones (at worst the caller alone)
+ * mount everything.
+ *
+ * @param fcbs Partitions to mount, each configured as for fcb_mount().
+ * @param count Number of partitions.
+ * @param rcs Optional array of count entries receiving the fcb_mount()
+ * result of each partition.
+ * @param workers Maximum number of threads, 0 for one per online CPU.
+ * @return int Number of partitions that failed to mount, or -1 on invalid
+ * arguments.
+ */
+int fcb_mount_many(Fcb *const *fcbs, size_t count, int *rcs,
+                   unsigned workers);
+
+#endif // FCB_MOUNT_MANY_H
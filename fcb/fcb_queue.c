@@ -0,0 +1,243 @@
+/**
+ * @file fcb_queue.c
+ * @brief Lock-free front-end queue for the Flash Circular Buffer
+ *
+ * Bounded multi-producer queue after Dmitry Vyukov's design. Every slot
+ * carries a turn counter: slot i is free for the producer that reserved
+ * position pos when seq == pos, and holds a record for the writer when
+ * seq == pos + 1. Releasing a slot advances seq by the ring size. Producers
+ * only contend on one compare-and-swap of enqueue_pos; a producer that is
+ * preempted between reserving and publishing a slot delays the writer at
+ * that slot but never blocks the other producers.
+ */
+
+#include "fcb_queue.h"
+#include <string.h>
+
+/*============================================================================
+ * Private Function Prototypes
+ *============================================================================*/
+
+static uint32_t fcb_queue_ready(FcbQueue *q, size_t max);
+static void fcb_queue_release(FcbQueue *q, uint32_t count);
+
+/*============================================================================
+ * Private Functions
+ *============================================================================*/
+
+/**
+ * @brief Count published records at the head of the queue.
+ *
+ * @param q Pointer to the queue.
+ * @param max Maximum number of records to count.
+ * @return uint32_t Number of consecutive records ready for the writer.
+ */
+static uint32_t fcb_queue_ready(FcbQueue *q, size_t max)
+{
+  uint32_t n = 0;
+
+  while (n < max)
+  {
+    uint32_t pos = q->dequeue_pos + n;
+    FcbQueueSlot *slot = &q->slots[pos & q->mask];
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+    {
+      break;
+    }
+
+    n++;
+  }
+
+  return n;
+}
+
+/**
+ * @brief Hand drained slots back to the producers.
+ *
+ * @param q Pointer to the queue.
+ * @param count Number of slots to release.
+ */
+static void fcb_queue_release(FcbQueue *q, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t pos = q->dequeue_pos;
+    FcbQueueSlot *slot = &q->slots[pos & q->mask];
+
+    atomic_store_explicit(&slot->seq, pos + q->mask + 1, memory_order_release);
+    q->dequeue_pos = pos + 1;
+  }
+}
+
+/*============================================================================
+ * Public Functions
+ *============================================================================*/
+
+int fcb_queue_init(FcbQueue *q, Fcb *fcb, FcbQueueSlot *slots, uint32_t count)
+{
+  if (q == NULL || fcb == NULL || slots == NULL || count < 2 ||
+      (count & (count - 1)) != 0)
+  {
+    return -1;
+  }
+
+  q->fcb = fcb;
+  q->slots = slots;
+  q->mask = count - 1;
+  q->dequeue_pos = 0;
+  atomic_init(&q->enqueue_pos, 0);
+  atomic_init(&q->backpressure, 0);
+
+  for (uint32_t i = 0; i < FCB_QUEUE_MAX_PRODUCERS; i++)
+  {
+    atomic_init(&q->drops[i], 0);
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    atomic_init(&slots[i].seq, i);
+  }
+
+  return 0;
+}
+
+int fcb_queue_push(FcbQueue *q, uint8_t producer, const void *data,
+                   uint16_t len)
+{
+  if (q == NULL || data == NULL || len == 0 || len > FCB_QUEUE_ITEM_MAX)
+  {
+    return -1;
+  }
+
+  FcbQueueSlot *slot;
+  uint32_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+
+  for (;;)
+  {
+    slot = &q->slots[pos & q->mask];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    int32_t diff = (int32_t)(seq - pos);
+
+    if (diff == 0)
+    {
+      /* Slot is free for this position, try to reserve it */
+      if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+      {
+        break;
+      }
+    } else if (diff < 0)
+    {
+      /* The writer has not released this slot yet: queue is full */
+      uint32_t id = (producer < FCB_QUEUE_MAX_PRODUCERS)
+                        ? producer
+                        : FCB_QUEUE_MAX_PRODUCERS - 1;
+      atomic_fetch_add_explicit(&q->drops[id], 1, memory_order_relaxed);
+      return -2;
+    } else
+    {
+      /* Another producer took this position, retry with the current one */
+      pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  memcpy(slot->data, data, len);
+  slot->len = len;
+
+  /* Publish the record to the writer */
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+  return 0;
+}
+
+int fcb_queue_drain(FcbQueue *q, size_t max)
+{
+  if (q == NULL)
+  {
+    return -1;
+  }
+
+  int written = 0;
+
+  while ((size_t)written < max)
+  {
+    size_t want = max - (size_t)written;
+    uint32_t n = fcb_queue_ready(q, (want < FCB_QUEUE_BATCH) ? want
+                                                             : FCB_QUEUE_BATCH);
+    if (n == 0)
+    {
+      break;
+    }
+
+    FcbIovec iov[FCB_QUEUE_BATCH];
+    for (uint32_t i = 0; i < n; i++)
+    {
+      FcbQueueSlot *slot = &q->slots[(q->dequeue_pos + i) & q->mask];
+      iov[i].iov_base = slot->data;
+      iov[i].iov_len = slot->len;
+    }
+
+    /* Only the records the batch committed leave the queue */
+    int committed = fcb_append_batch(q->fcb, iov, n);
+    if (committed < 0)
+    {
+      return committed;
+    }
+
+    fcb_queue_release(q, (uint32_t)committed);
+    written += committed;
+
+    if ((uint32_t)committed < n)
+    {
+      /* The batch stopped early, find out why from a single append */
+      int rc = fcb_append(q->fcb, iov[committed].iov_base,
+                          iov[committed].iov_len);
+      if (rc != 0)
+      {
+        if (rc == -2)
+        {
+          atomic_store_explicit(&q->backpressure, 1, memory_order_relaxed);
+        }
+
+        /* A flash error is reported even if records were written before */
+        return (written > 0 && rc != -3) ? written : rc;
+      }
+
+      fcb_queue_release(q, 1);
+      written++;
+    }
+  }
+
+  if (written > 0)
+  {
+    atomic_store_explicit(&q->backpressure, 0, memory_order_relaxed);
+  }
+
+  return written;
+}
+
+uint32_t fcb_queue_drops(FcbQueue *q, uint8_t producer)
+{
+  if (q == NULL)
+  {
+    return 0;
+  }
+
+  uint32_t id = (producer < FCB_QUEUE_MAX_PRODUCERS)
+                    ? producer
+                    : FCB_QUEUE_MAX_PRODUCERS - 1;
+
+  return atomic_load_explicit(&q->drops[id], memory_order_relaxed);
+}
+
+int fcb_queue_backpressure(FcbQueue *q)
+{
+  if (q == NULL)
+  {
+    return 0;
+  }
+
+  return atomic_load_explicit(&q->backpressure, memory_order_relaxed);
+}
@@ -0,0 +1,117 @@
+#ifndef FCB_QUEUE_H
+#define FCB_QUEUE_H
+
+#include "fcb.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Largest record a producer can queue, in bytes.
+ */
+#ifndef FCB_QUEUE_ITEM_MAX
+#define FCB_QUEUE_ITEM_MAX 64
+#endif
+
+/**
+ * @brief Number of producer IDs that get their own drop counter.
+ */
+#ifndef FCB_QUEUE_MAX_PRODUCERS
+#define FCB_QUEUE_MAX_PRODUCERS 8
+#endif
+
+/**
+ * @brief Maximum number of records handed to fcb_append_batch() at once.
+ */
+#ifndef FCB_QUEUE_BATCH
+#define FCB_QUEUE_BATCH 16
+#endif
+
+/**
+ * @brief One record slot of the queue ring.
+ */
+typedef struct {
+  _Atomic uint32_t seq; /**< Slot turn counter (see fcb_queue.c) */
+  uint16_t len;         /**< Payload length in bytes */
+  uint8_t data[FCB_QUEUE_ITEM_MAX]; /**< Record payload */
+} FcbQueueSlot;
+
+/**
+ * @brief Multi-producer, single-consumer RAM queue in front of an FCB.
+ *
+ * Producers (tasks or ISRs) reserve slots with atomic operations only and
+ * never wait; a single writer task drains the queue into flash in batches.
+ */
+typedef struct {
+  Fcb *fcb;            /**< FCB the writer drains into */
+  FcbQueueSlot *slots; /**< Caller provided slot array */
+  uint32_t mask;       /**< Slot count - 1 (the count is a power of two) */
+  _Atomic uint32_t enqueue_pos; /**< Next slot producers reserve */
+  uint32_t dequeue_pos;         /**< Next slot the writer drains */
+  _Atomic uint32_t drops[FCB_QUEUE_MAX_PRODUCERS]; /**< Records dropped per
+                                                      producer */
+  _Atomic int backpressure; /**< Set while the FCB is full */
+} FcbQueue;
+
+/**
+ * @brief Initialize a queue over a caller provided slot array.
+ *
+ * @param q Pointer to the queue.
+ * @param fcb Mounted FCB the queue drains into.
+ * @param slots Slot storage.
+ * @param count Number of slots, a power of two of at least 2.
+ * @return int 0 on success, -1 on invalid arguments.
+ */
+int fcb_queue_init(FcbQueue *q, Fcb *fcb, FcbQueueSlot *slots, uint32_t count);
+
+/**
+ * @brief Queue a record for writing. Safe to call from any context.
+ *
+ * @param q Pointer to the queue.
+ * @param producer Producer ID used for drop accounting; IDs from
+ * FCB_QUEUE_MAX_PRODUCERS - 1 upwards share the last counter.
+ * @param data Record payload.
+ * @param len Payload length, 1 to FCB_QUEUE_ITEM_MAX bytes.
+ * @return int 0 on success, -1 on invalid arguments, -2 if the queue is full
+ * and the record was dropped.
+ */
+int fcb_queue_push(FcbQueue *q, uint8_t producer, const void *data,
+                   uint16_t len);
+
+/**
+ * @brief Write queued records to flash. Only one task may call this.
+ *
+ * Records that do not fit because the FCB is full stay queued and the
+ * backpressure flag is raised until a later drain succeeds. Records a flash
+ * error kept out of flash stay queued as well, and the error is returned
+ * even when records were written before it.
+ *
+ * @param q Pointer to the queue.
+ * @param max Maximum number of records to write.
+ * @return int Number of records written, -1 on invalid arguments, -2 if the
+ * FCB is full, -3 on flash error, or another fcb_append() error code.
+ */
+int fcb_queue_drain(FcbQueue *q, size_t max);
+
+/**
+ * @brief Number of records a producer has lost to a full queue.
+ *
+ * @param q Pointer to the queue.
+ * @param producer Producer ID, IDs from FCB_QUEUE_MAX_PRODUCERS - 1 upwards
+ * share the last counter.
+ * @return uint32_t Drop count (wraps around).
+ */
+uint32_t fcb_queue_drops(FcbQueue *q, uint8_t producer);
+
+/**
+ * @brief Check whether the FCB behind the queue is full.
+ *
+ * Producers can use this to throttle or skip low-priority records before
+ * the queue itself overflows.
+ *
+ * @param q Pointer to the queue.
+ * @return int 1 while the last drain hit a full FCB, 0 otherwise.
+ */
+int fcb_queue_backpressure(FcbQueue *q);
+
+#endif // FCB_QUEUE_H
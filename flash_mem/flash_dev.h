@@ -0,0 +1,64 @@
+#ifndef FLASH_DEV_H
+#define FLASH_DEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Completion callback of an asynchronous flash operation.
+ *
+ * @param rc 0 on success, negative error code otherwise.
+ * @param arg User argument passed when the operation was started.
+ */
+typedef void (*flash_done_cb)(int rc, void *arg);
+
+/**
+ * @brief Flash backend operations.
+ *
+ * All addresses are absolute device addresses and all functions return 0 on
+ * success or a negative error code. A program operation never crosses a
+ * page boundary (callers split writes at FlashDev.page_size), and only
+ * clears bits. Erase ranges are multiples of FlashDev.erase_size.
+ */
+typedef struct
+{
+    /** Read len bytes at addr into data. */
+    int (*read)(void *ctx, uint32_t addr, void *data, uint32_t len);
+
+    /** Program len bytes at addr, blocking until done. */
+    int (*program)(void *ctx, uint32_t addr, const void *data, uint32_t len);
+
+    /** Erase len bytes at addr, blocking until done. */
+    int (*erase)(void *ctx, uint32_t addr, uint32_t len);
+
+    /**
+     * Start programming and return immediately (optional, may be NULL).
+     * data must stay valid until done is called. Returns -2 while another
+     * operation is still in progress.
+     */
+    int (*program_async)(void *ctx, uint32_t addr, const void *data,
+                         uint32_t len, flash_done_cb done, void *arg);
+
+    /**
+     * Start an erase and return immediately (optional, may be NULL).
+     * Returns -2 while another operation is still in progress.
+     */
+    int (*erase_async)(void *ctx, uint32_t addr, uint32_t len,
+                       flash_done_cb done, void *arg);
+} FlashOps;
+
+/**
+ * @brief A flash device as seen by the FCB.
+ */
+typedef struct
+{
+    const FlashOps *ops; /**< Backend operations */
+    void *ctx;           /**< Backend private context passed to every op */
+    uint32_t size;       /**< Device size in bytes */
+    uint32_t erase_size; /**< Erase granularity in bytes */
+    uint32_t page_size;  /**< Program page size in bytes */
+    const uint8_t *base; /**< Memory-mapped (XIP) view of the device, or NULL
+                              if it can only be read through ops->read */
+} FlashDev;
+
+#endif // FLASH_DEV_H
@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "flash_file.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*============================================================================
+ * FlashDev Backend
+ *============================================================================*/
+
+static int flash_file_dev_read(void* ctx, uint32_t addr, void* data,
+                               uint32_t len)
+{
+    FlashFile* ff = (FlashFile*)ctx;
+    if (addr > ff->dev.size || len > ff->dev.size - addr)
+    {
+        return -1;
+    }
+    memcpy(data, &ff->map[addr], len);
+    return 0;
+}
+
+static int flash_file_dev_program(void* ctx, uint32_t addr, const void* data,
+                                  uint32_t len)
+{
+    FlashFile* ff = (FlashFile*)ctx;
+    if (addr > ff->dev.size || len > ff->dev.size - addr ||
+        len > ff->dev.page_size)
+    {
+        return -1;
+    }
+
+    // Programming can only clear bits
+    const uint8_t* src = (const uint8_t*)data;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        ff->map[addr + i] &= src[i];
+    }
+    return 0;
+}
+
+static int flash_file_dev_erase(void* ctx, uint32_t addr, uint32_t len)
+{
+    FlashFile* ff = (FlashFile*)ctx;
+    if (addr > ff->dev.size || len > ff->dev.size - addr ||
+        addr % ff->dev.erase_size != 0 || len % ff->dev.erase_size != 0)
+    {
+        return -1;
+    }
+    memset(&ff->map[addr], 0xFF, len);
+    return 0;
+}
+
+static const FlashOps flash_file_ops = {
+    .read = flash_file_dev_read,
+    .program = flash_file_dev_program,
+    .erase = flash_file_dev_erase,
+    .program_async = NULL,
+    .erase_async = NULL,
+};
+
+/*============================================================================
+ * Public Functions
+ *============================================================================*/
+
+int flash_file_open(FlashFile* ff, const char* path, uint32_t size,
+                    uint32_t erase_size, uint32_t page_size, int flags)
+{
+    if (ff == NULL || path == NULL || erase_size == 0 || page_size == 0 ||
+        erase_size % page_size != 0 ||
+        (flags & (FLASH_FILE_CREATE | FLASH_FILE_PRIVATE)) ==
+            (FLASH_FILE_CREATE | FLASH_FILE_PRIVATE))
+    {
+        return -1;
+    }
+
+    int private_map = (flags & FLASH_FILE_PRIVATE) != 0;
+    int open_flags = private_map ? O_RDONLY : O_RDWR;
+    if (flags & FLASH_FILE_CREATE)
+    {
+        open_flags |= O_CREAT;
+    }
+
+    int fd = open(path, open_flags, 0644);
+    if (fd < 0)
+    {
+        return -2;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return -2;
+    }
+
+    uint64_t file_size = (uint64_t)st.st_size;
+    uint64_t dev_size = (size != 0) ? size : file_size;
+    if (dev_size == 0 || dev_size > UINT32_MAX || dev_size % erase_size != 0 ||
+        (file_size < dev_size && !(flags & FLASH_FILE_CREATE)))
+    {
+        close(fd);
+        return -1;
+    }
+
+    if (file_size < dev_size && ftruncate(fd, (off_t)dev_size) != 0)
+    {
+        close(fd);
+        return -2;
+    }
+
+    void* map = mmap(NULL, (size_t)dev_size, PROT_READ | PROT_WRITE,
+                     private_map ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return -2;
+    }
+
+    ff->map = (uint8_t*)map;
+    ff->fd = fd;
+
+    // The extension reads back as zeros, erase it like a fresh part
+    if (file_size < dev_size)
+    {
+        memset(&ff->map[file_size], 0xFF, (size_t)(dev_size - file_size));
+    }
+
+    ff->dev.ops = &flash_file_ops;
+    ff->dev.ctx = ff;
+    ff->dev.size = (uint32_t)dev_size;
+    ff->dev.erase_size = erase_size;
+    ff->dev.page_size = page_size;
+    ff->dev.base = ff->map;
+
+    return 0;
+}
+
+int flash_file_sync(FlashFile* ff)
+{
+    if (ff == NULL || ff->map == NULL)
+    {
+        return -1;
+    }
+    return (msync(ff->map, ff->dev.size, MS_SYNC) == 0) ? 0 : -2;
+}
+
+void flash_file_close(FlashFile* ff)
+{
+    if (ff == NULL || ff->map == NULL)
+    {
+        return;
+    }
+    munmap(ff->map, ff->dev.size);
+    close(ff->fd);
+    ff->map = NULL;
+    ff->fd = -1;
+}
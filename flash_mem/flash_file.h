@@ -0,0 +1,63 @@
+#ifndef FLASH_FILE_H
+#define FLASH_FILE_H
+
+#include "flash_dev.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLASH_FILE_CREATE 0x1  /**< Create or extend the image, erased (FF) */
+#define FLASH_FILE_PRIVATE 0x2 /**< Keep changes in memory, never write them
+                                    back to the image */
+
+/**
+ * @brief A flash image file mapped into memory as a FlashDev backend.
+ *
+ * The image is mapped, not loaded, so large dumps only occupy the pages
+ * that are touched. Device addresses are 32 bits, which limits images to
+ * just under 4 GiB. dev.base points at the mapping, which makes the FCB
+ * scan it in place. Programming only clears bits and erasing sets them,
+ * as on the real part; the asynchronous operations are not provided.
+ */
+typedef struct
+{
+    FlashDev dev; /**< The backend handed to Fcb.dev */
+    uint8_t* map; /**< Start of the mapping */
+    int fd;       /**< Image file descriptor */
+} FlashFile;
+
+/**
+ * @brief Map a flash image file.
+ *
+ * @param ff Backend to initialize.
+ * @param path Path of the image.
+ * @param size Device size in bytes, or 0 to use the size of the image.
+ * @param erase_size Erase granularity in bytes.
+ * @param page_size Program page size in bytes.
+ * @param flags FLASH_FILE_CREATE or FLASH_FILE_PRIVATE (not both, a private
+ * mapping cannot grow the image).
+ * @return int 0 on success, -1 on invalid arguments or geometry, or if the
+ * image is smaller than size without FLASH_FILE_CREATE, -2 if the file could
+ * not be opened or mapped.
+ */
+int flash_file_open(FlashFile* ff, const char* path, uint32_t size,
+                    uint32_t erase_size, uint32_t page_size, int flags);
+
+/**
+ * @brief Write changes back to the image.
+ *
+ * Without this, changes reach the file when the kernel writes the pages
+ * back or at flash_file_close(). Does nothing for FLASH_FILE_PRIVATE images.
+ *
+ * @param ff Mapped backend.
+ * @return int 0 on success, -1 if ff is not mapped, -2 on an I/O error.
+ */
+int flash_file_sync(FlashFile* ff);
+
+/**
+ * @brief Unmap the image and close the file.
+ *
+ * @param ff Mapped backend.
+ */
+void flash_file_close(FlashFile* ff);
+
+#endif // FLASH_FILE_H
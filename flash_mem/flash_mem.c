@@ -4,16 +4,74 @@
 
 static uint8_t fcb_flash[FLASH_SIZE];
 
-void flash_write(uint32_t addr, const void* data, uint16_t len)
+/**
+ * @brief Asynchronous operation waiting for flash_mem_poll().
+ */
+static struct
+{
+    int busy;
+    int is_erase;
+    uint32_t addr;
+    uint32_t len;
+    const void* data;
+    flash_done_cb done;
+    void* arg;
+} flash_mem_pending;
+
+/**
+ * @brief Active timing model and the simulated clock it drives.
+ */
+static FlashMemCost flash_mem_cost;
+static uint64_t flash_mem_elapsed;
+
+/**
+ * @brief Power-cut injection state.
+ */
+static struct
+{
+    int armed;       /* Cut once budget bytes have been programmed or erased */
+    int lost;        /* Power is off, program and erase are rejected */
+    uint32_t budget; /* Bytes left before the cut */
+} flash_mem_power;
+
+/**
+ * @brief Consume the power-cut budget for an operation.
+ *
+ * @param len Bytes the operation wants to change.
+ * @return uint32_t Bytes the operation may complete before power is lost.
+ */
+static uint32_t flash_mem_power_take(uint32_t len)
+{
+    if (!flash_mem_power.armed)
+    {
+        return len;
+    }
+    if (len < flash_mem_power.budget)
+    {
+        flash_mem_power.budget -= len;
+        return len;
+    }
+    uint32_t done = flash_mem_power.budget;
+    flash_mem_power.armed = 0;
+    flash_mem_power.lost = 1;
+    return done;
+}
+
+void flash_write(uint32_t addr, const void* data, uint32_t len)
 {
     if (addr + len > FLASH_SIZE)
     {
         return; // Simple bounds check
     }
-    memcpy(&fcb_flash[addr], data, len);
+    // Programming can only clear bits
+    const uint8_t* src = (const uint8_t*)data;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        fcb_flash[addr + i] &= src[i];
+    }
 }
 
-void flash_read(uint32_t addr, void* data, uint16_t size)
+void flash_read(uint32_t addr, void* data, uint32_t size)
 {
     if (addr + size > FLASH_SIZE)
     {
@@ -40,6 +98,210 @@ void flash_full_erase(void)
     memset(fcb_flash, 0xFF, FLASH_SIZE);
 }
 
+/*============================================================================
+ * Timing Model
+ *============================================================================*/
+
+void flash_mem_set_cost(const FlashMemCost* cost)
+{
+    if (cost == NULL)
+    {
+        memset(&flash_mem_cost, 0, sizeof(flash_mem_cost));
+        return;
+    }
+    flash_mem_cost = *cost;
+}
+
+uint64_t flash_mem_elapsed_ns(void)
+{
+    return flash_mem_elapsed;
+}
+
+void flash_mem_reset_elapsed(void)
+{
+    flash_mem_elapsed = 0;
+}
+
+/*============================================================================
+ * Power-Cut Injection
+ *============================================================================*/
+
+void flash_mem_cut_power(uint32_t after_bytes)
+{
+    flash_mem_power.armed = 1;
+    flash_mem_power.lost = 0;
+    flash_mem_power.budget = after_bytes;
+}
+
+int flash_mem_power_lost(void)
+{
+    return flash_mem_power.lost;
+}
+
+void flash_mem_restore_power(void)
+{
+    flash_mem_power.armed = 0;
+    flash_mem_power.lost = 0;
+}
+
+/*============================================================================
+ * FlashDev Backend
+ *============================================================================*/
+
+static int flash_mem_dev_read(void* ctx, uint32_t addr, void* data,
+                              uint32_t len)
+{
+    (void)ctx;
+    if (addr > FLASH_SIZE || len > FLASH_SIZE - addr)
+    {
+        return -1;
+    }
+    memcpy(data, &fcb_flash[addr], len);
+    flash_mem_elapsed +=
+        ((uint64_t)len * flash_mem_cost.read_ns_per_kb + 1023) / 1024;
+    return 0;
+}
+
+static int flash_mem_dev_program(void* ctx, uint32_t addr, const void* data,
+                                 uint32_t len)
+{
+    (void)ctx;
+    if (addr > FLASH_SIZE || len > FLASH_SIZE - addr || len > FLASH_PAGE_SIZE)
+    {
+        return -1;
+    }
+    if (flash_mem_power.lost)
+    {
+        return -1;
+    }
+
+    // Like a real part, the address wraps within the page being programmed
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t page = addr - (addr % FLASH_PAGE_SIZE);
+    uint32_t done = flash_mem_power_take(len);
+    for (uint32_t i = 0; i < done; i++)
+    {
+        fcb_flash[page + (addr + i) % FLASH_PAGE_SIZE] &= src[i];
+    }
+    flash_mem_elapsed += flash_mem_cost.page_program_ns;
+
+    if (done < len)
+    {
+        // The byte being programmed when power failed keeps some old bits
+        uint32_t at = page + (addr + done) % FLASH_PAGE_SIZE;
+        uint8_t kept = (uint8_t)((at * 0x9E3779B1u) >> 24);
+        fcb_flash[at] &= src[done] | kept;
+        return -1;
+    }
+    return 0;
+}
+
+static int flash_mem_dev_erase(void* ctx, uint32_t addr, uint32_t len)
+{
+    (void)ctx;
+    if (addr % FLASH_ERASE_SIZE != 0 || len % FLASH_ERASE_SIZE != 0 ||
+        addr > FLASH_SIZE || len > FLASH_SIZE - addr)
+    {
+        return -1;
+    }
+    if (flash_mem_power.lost)
+    {
+        return -1;
+    }
+
+    uint32_t done = flash_mem_power_take(len);
+    memset(&fcb_flash[addr], 0xFF, done);
+    flash_mem_elapsed += (uint64_t)(len / FLASH_ERASE_SIZE) *
+                         flash_mem_cost.erase_ns;
+    return (done < len) ? -1 : 0;
+}
+
+static int flash_mem_dev_program_async(void* ctx, uint32_t addr,
+                                       const void* data, uint32_t len,
+                                       flash_done_cb done, void* arg)
+{
+    (void)ctx;
+    if (flash_mem_pending.busy)
+    {
+        return -2;
+    }
+    flash_mem_pending.busy = 1;
+    flash_mem_pending.is_erase = 0;
+    flash_mem_pending.addr = addr;
+    flash_mem_pending.len = len;
+    flash_mem_pending.data = data;
+    flash_mem_pending.done = done;
+    flash_mem_pending.arg = arg;
+    return 0;
+}
+
+static int flash_mem_dev_erase_async(void* ctx, uint32_t addr, uint32_t len,
+                                     flash_done_cb done, void* arg)
+{
+    (void)ctx;
+    if (flash_mem_pending.busy)
+    {
+        return -2;
+    }
+    flash_mem_pending.busy = 1;
+    flash_mem_pending.is_erase = 1;
+    flash_mem_pending.addr = addr;
+    flash_mem_pending.len = len;
+    flash_mem_pending.data = NULL;
+    flash_mem_pending.done = done;
+    flash_mem_pending.arg = arg;
+    return 0;
+}
+
+int flash_mem_poll(void)
+{
+    if (!flash_mem_pending.busy)
+    {
+        return 0;
+    }
+
+    int rc;
+    if (flash_mem_pending.is_erase)
+    {
+        rc = flash_mem_dev_erase(NULL, flash_mem_pending.addr,
+                                 flash_mem_pending.len);
+    }
+    else
+    {
+        rc = flash_mem_dev_program(NULL, flash_mem_pending.addr,
+                                   flash_mem_pending.data,
+                                   flash_mem_pending.len);
+    }
+
+    /* Clear first so the callback may start the next operation */
+    flash_done_cb done = flash_mem_pending.done;
+    void* arg = flash_mem_pending.arg;
+    flash_mem_pending.busy = 0;
+
+    if (done != NULL)
+    {
+        done(rc, arg);
+    }
+    return 1;
+}
+
+static const FlashOps flash_mem_ops = {
+    .read = flash_mem_dev_read,
+    .program = flash_mem_dev_program,
+    .erase = flash_mem_dev_erase,
+    .program_async = flash_mem_dev_program_async,
+    .erase_async = flash_mem_dev_erase_async,
+};
+
+const FlashDev flash_mem_dev = {
+    .ops = &flash_mem_ops,
+    .ctx = NULL,
+    .size = FLASH_SIZE,
+    .erase_size = FLASH_ERASE_SIZE,
+    .page_size = FLASH_PAGE_SIZE,
+    .base = fcb_flash,
+};
+
 void flash_print_sector(uint32_t addr, uint32_t num_bytes)
 {
     uint32_t base_addr = addr - (addr % FLASH_SECTOR_SIZE);
@@ -1,21 +1,90 @@
 #ifndef FLASH_MEM_H
 #define FLASH_MEM_H
 
+#include "flash_dev.h"
 #include <stdint.h>
 #include <stddef.h>
 
 #define FLASH_SECTOR_SIZE (64 * 1024)
 #define FLASH_SECTOR_COUNT 64
 #define FLASH_SIZE (FLASH_SECTOR_SIZE * FLASH_SECTOR_COUNT)
+#define FLASH_PAGE_SIZE 256
+#define FLASH_ERASE_SIZE (4 * 1024) /**< Smallest erase unit of flash_mem_dev */
 
 /**
- * @brief Write data to flash.
+ * @brief The emulated flash as a FlashDev backend.
+ *
+ * The asynchronous operations are queued (one at a time) and complete on the
+ * next call to flash_mem_poll().
+ */
+extern const FlashDev flash_mem_dev;
+
+/**
+ * @brief Timing model of the emulated part.
+ *
+ * When set, every FlashDev operation adds its modelled duration to a
+ * simulated clock instead of sleeping, so benchmarks run at host speed but
+ * can report device time. The legacy flash_* functions are not modelled.
+ */
+typedef struct
+{
+    uint32_t page_program_ns; /**< Duration of one program call (<= a page) */
+    uint32_t erase_ns;        /**< Duration per FLASH_ERASE_SIZE block */
+    uint32_t read_ns_per_kb;  /**< Read time per KiB (inverse bandwidth) */
+} FlashMemCost;
+
+/**
+ * @brief Install a timing model for flash_mem_dev.
+ *
+ * @param cost The model to use, or NULL to stop accounting.
+ */
+void flash_mem_set_cost(const FlashMemCost* cost);
+
+/**
+ * @brief Simulated device time accumulated under the timing model.
+ *
+ * @return uint64_t Modelled nanoseconds since the last reset.
+ */
+uint64_t flash_mem_elapsed_ns(void);
+
+/**
+ * @brief Restart the simulated device clock at zero.
+ */
+void flash_mem_reset_elapsed(void);
+
+/**
+ * @brief Cut power after a number of bytes have been changed.
+ *
+ * Every FlashDev program or erase consumes the budget by the bytes it
+ * changes. The operation that exhausts it completes only its first bytes
+ * (a program also leaves the next byte partially programmed) and fails,
+ * as do all program and erase operations after it, until
+ * flash_mem_restore_power(). Reads keep working.
+ *
+ * @param after_bytes Bytes that still complete before the cut.
+ */
+void flash_mem_cut_power(uint32_t after_bytes);
+
+/**
+ * @brief Check whether an injected power cut has happened.
+ *
+ * @return int 1 after the cut, 0 otherwise.
+ */
+int flash_mem_power_lost(void);
+
+/**
+ * @brief Disarm power-cut injection and power the part up again.
+ */
+void flash_mem_restore_power(void);
+
+/**
+ * @brief Write data to flash. Like programming, this only clears bits.
  * 
  * @param addr Destination address in flash.
  * @param data Source data buffer.
  * @param len Number of bytes to write.
  */
-void flash_write(uint32_t addr, const void* data, uint16_t len);
+void flash_write(uint32_t addr, const void* data, uint32_t len);
 
 /**
  * @brief Read data from flash.
@@ -24,7 +93,7 @@ void flash_write(uint32_t addr, const void* data, uint16_t len);
  * @param data Destination buffer.
  * @param size Number of bytes to read.
  */
-void flash_read(uint32_t addr, void* data, uint16_t size);
+void flash_read(uint32_t addr, void* data, uint32_t size);
 
 /**
  * @brief Erase a flash sector (64KB).
@@ -38,6 +107,16 @@ void flash_erase_sector(uint32_t base_addr);
  */
 void flash_full_erase(void);
 
+/**
+ * @brief Complete the pending asynchronous operation, if any.
+ *
+ * Stands in for the "operation done" interrupt of a real part and invokes
+ * the completion callback.
+ *
+ * @return int 1 if an operation completed, 0 if none was pending.
+ */
+int flash_mem_poll(void);
+
 /**
  * @brief Print sector contents for debugging.
  * 
@@ -3,8 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 
-Fcb fcb = {
-    .first_sector = 0, .last_sector = 63, .sector_size = FLASH_SECTOR_SIZE};
+FCB_DEFINE(fcb, &flash_mem_dev, 0, 63, FLASH_SECTOR_SIZE, 0);
 
 int main() {
   printf("Hello from FCB Test!\n");
@@ -52,6 +51,18 @@ int main() {
 
   flash_print_sector(0, 256);
 
+  printf("\n--- Drain ---\n");
+  char buf[128];
+  uint16_t len;
+  while (fcb_read(&fcb, buf, sizeof(buf), &len) == 0)
+  {
+    printf("Read %u bytes: \"%.*s\"\n", len, (int)len, buf);
+    fcb_pop(&fcb);
+  }
+
+  printf("  Read Addr:   0x%08X\n", fcb.read_addr);
+  printf("  Delete Addr: 0x%08X\n", fcb.delete_addr);
+
   return 0;
 }
 